@@ -1,12 +1,18 @@
 #version 330 core
 layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec2 a_Normal;
+// per instance
+layout (location = 3) in mat4 a_Model;
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
 
 void main()
 {
-	gl_Position = u_Projection * u_View * u_Model * vec4(a_Pos, 1.0f);
+	gl_Position = u_Projection * u_View * a_Model * vec4(a_Pos, 1.0f);
 }
\ No newline at end of file
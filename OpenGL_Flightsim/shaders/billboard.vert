@@ -3,19 +3,24 @@ layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec2 a_TexCoord;
 
 uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
 uniform vec3 u_Position;
-uniform vec3 u_Up;
-uniform vec3 u_Right;
 uniform vec3 u_Scale;
 
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
+
 out vec2 TexCoords;
 
 void main()
 {
-	vec3 Up = u_Up;
-	vec3 Right = u_Right;
+	// camera axes in world space
+	vec3 Up = vec3(u_View[0][1], u_View[1][1], u_View[2][1]);
+	vec3 Right = vec3(u_View[0][0], u_View[1][0], u_View[2][0]);
 	vec3 Pos = a_Pos * u_Scale;
 	//vec3 Pos = a_Pos;
 
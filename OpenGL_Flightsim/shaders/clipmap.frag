@@ -2,11 +2,21 @@
 
 out vec4 FragColor;
 
-uniform float u_Level;
-uniform vec3 u_Background;
-uniform sampler2D u_Heightmap;
-uniform sampler2D u_Normalmap;
-uniform sampler2D u_Texture;
+
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
+
+// same as in clipmap.vert
+const int MAX_CLIP_LEVELS = 8;
+uniform sampler2DArray u_ClipAlbedo;
+uniform vec4 u_ClipValid[MAX_CLIP_LEVELS];
+uniform vec4 u_ClipScale[MAX_CLIP_LEVELS];
+uniform int u_ClipLevels;
 
 in vec3 Color;
 in vec3 Normal;
@@ -14,6 +24,30 @@ in vec3 FragPos;
 in vec2 TexCoord;
 flat in int Factor;
 
+// finest level that has the point and isn't finer than the screen needs
+int getClipLevel(vec2 uv, int finest)
+{
+  for (int level = finest; level < u_ClipLevels - 1; level++)
+  {
+    vec4 valid = u_ClipValid[level];
+    if (all(greaterThanEqual(uv, valid.xy)) && all(lessThanEqual(uv, valid.zw)))
+    {
+      return level;
+    }
+  }
+  return u_ClipLevels - 1;
+}
+
+vec3 getAlbedo(vec2 uv)
+{
+  vec2 texels = uv * u_ClipScale[0].xy * vec2(textureSize(u_ClipAlbedo, 0).xy);
+  float footprint = max(length(dFdx(texels)), length(dFdy(texels)));
+  int finest = clamp(int(floor(log2(max(footprint, 1.0)))), 0, u_ClipLevels - 1);
+
+  int level = getClipLevel(uv, finest);
+  return texture(u_ClipAlbedo, vec3(uv * u_ClipScale[level].xy, level)).rgb;
+}
+
 vec3 calculateDirLight(vec3 direction, vec3 normal, vec3 color)
 {
 	float ka = 0.6;
@@ -37,12 +71,12 @@ void main()
   // Calculate fog
   float fogMaxdist = 64000.0;
   float fogMindist = 1000.0;
-  vec4 fogColor = vec4(u_Background, 1.0);
+  vec4 fogColor = vec4(u_BackgroundColor, 1.0);
 
   float dist = length(FragPos.xyz);
   float fogFactor = (fogMaxdist - dist) / (fogMaxdist - fogMindist);
   fogFactor = clamp(fogFactor, 0.0, 1.0);
 
-  vec4 terrainColor = vec4(calculateDirLight(lightDir, Normal, texture(u_Texture, TexCoord).rgb), 1.0);
+  vec4 terrainColor = vec4(calculateDirLight(lightDir, Normal, getAlbedo(TexCoord)), 1.0);
   FragColor = mix(fogColor, terrainColor, fogFactor);
 }
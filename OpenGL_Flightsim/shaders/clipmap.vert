@@ -1,17 +1,25 @@
 #version 330 core
 layout (location = 0) in vec3 a_Pos;
+// per instance
+layout (location = 1) in vec4 a_Placement;  // offset x, offset z, scale, angle about y
+layout (location = 2) in float a_Level;
+
+layout (std140) uniform FrameData {
+    mat4 u_View;
+    mat4 u_Projection;
+    mat4 u_LightSpaceMatrix;
+    vec3 u_CameraPosition;
+    vec3 u_BackgroundColor;
+};
+
+// toroidal textures with a window of every level of the terrain, see ClipTextures
+const int MAX_CLIP_LEVELS = 8;
+uniform sampler2DArray u_ClipHeight;
+uniform sampler2DArray u_ClipNormal;
+uniform vec4 u_ClipValid[MAX_CLIP_LEVELS];  // uv rectangle of every level that can be sampled
+uniform vec4 u_ClipScale[MAX_CLIP_LEVELS];  // uv to texture coordinates in xy
+uniform int u_ClipLevels;
 
-uniform mat4 u_View;
-uniform mat4 u_Model;
-uniform mat4 u_Projection;
-
-uniform sampler2D u_Heightmap;
-uniform sampler2D u_Normalmap;
-
-uniform vec3    u_CameraPos;
-uniform float   u_Scale;
-uniform float   u_SegmentSize;
-uniform float   u_Level;
 
 out vec3 Color;
 out vec3 Normal;
@@ -25,15 +33,33 @@ float scale(float input_val, float in_min, float in_max, float out_min, float ou
     return (input_val - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
+// finest level that has the point, the coarsest level has the whole terrain
+int getClipLevel(vec2 uv)
+{
+    for (int level = 0; level < u_ClipLevels - 1; level++)
+    {
+        vec4 valid = u_ClipValid[level];
+        if (all(greaterThanEqual(uv, valid.xy)) && all(lessThanEqual(uv, valid.zw)))
+        {
+            return level;
+        }
+    }
+    return u_ClipLevels - 1;
+}
+
+vec3 getClipCoord(vec2 uv, int level)
+{
+    return vec3(uv * u_ClipScale[level].xy, level);
+}
+
 float getHeight(vec2 uv)
 {
-    if (uv.x < 0 || uv.x > 1 || uv.y < 0 || uv.x > 1)
+    if (uv.x < 0 || uv.x > 1 || uv.y < 0 || uv.y > 1)
     {
         return 0.0;
     }
 
-    float height = texture(u_Heightmap, uv).r;
-    float coarser = textureLod(u_Heightmap, uv, 1).r;
+    float height = texture(u_ClipHeight, getClipCoord(uv, getClipLevel(uv))).r;
 
     float scale = 3000;
     float shift = 0;
@@ -42,7 +68,15 @@ float getHeight(vec2 uv)
 
 vec3 getNormal(vec2 uv)
 {
-    return normalize(texture(u_Normalmap, uv).rgb);
+    return normalize(texture(u_ClipNormal, getClipCoord(uv, getClipLevel(uv))).rgb);
+}
+
+// same as translate * rotate * scale on the cpu
+vec3 place(vec3 pos)
+{
+    float s = sin(a_Placement.w), c = cos(a_Placement.w);
+    pos *= a_Placement.z;
+    return vec3(c * pos.x + s * pos.z + a_Placement.x, pos.y, -s * pos.x + c * pos.z + a_Placement.y);
 }
 
 vec2 getUV(vec2 pos)
@@ -57,14 +91,14 @@ void main()
 {
     Factor = 25000;
 
-    FragPos = vec3(u_Model * vec4(a_Pos, 1.0));
+    FragPos = place(a_Pos);
     TexCoord = getUV(FragPos.xz);
 
     FragPos.y = getHeight(TexCoord);
 
     Normal = getNormal(TexCoord);
 
-	Color = vec3(1.0, u_Level, 0.0);
+	Color = vec3(1.0, a_Level, 0.0);
 
     gl_Position = u_Projection * u_View * vec4(FragPos, 1.0);
 
@@ -1,10 +1,17 @@
 #version 330 core
 layout(location = 0) in vec3 a_Pos;
+// per instance
+layout (location = 3) in mat4 a_Model;
 
-uniform mat4 u_Model;
-uniform mat4 u_LightSpaceMatrix;
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
 
 void main()
 {
-	gl_Position = u_LightSpaceMatrix * u_Model * vec4(a_Pos, 1.0);
+	gl_Position = u_LightSpaceMatrix * a_Model * vec4(a_Pos, 1.0);
 }
\ No newline at end of file
@@ -5,8 +5,16 @@ in vec3 Normal;
 in vec3 FragPos;  
 in vec2 TexCoords;
 in vec4 FragPosLightSpace;
+flat in float ReceiveShadow;
   
-uniform vec3 u_CameraPosition; 
+// per frame, set once by the renderer
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
 
 // phong lighting parameters
 uniform float ka;
@@ -14,14 +22,12 @@ uniform float kd;
 uniform float ks;
 uniform float alpha;
 
-uniform bool u_ReceiveShadow;
 uniform sampler2D u_ShadowMap;
 
 uniform bool u_UseTexture;
 uniform sampler2D u_Texture1;
 
 uniform vec3 u_SolidObjectColor;
-uniform vec3 u_BackgroundColor;
 
 struct Light {
 	int type; // POINT = 0, DIRECTIONAL = 1
@@ -30,8 +36,10 @@ struct Light {
 };
 
 #define MAX_LIGHTS 4
-uniform int u_NumLights;
-uniform Light u_Lights[MAX_LIGHTS];
+layout (std140) uniform LightData {
+	int u_NumLights;
+	Light u_Lights[MAX_LIGHTS];
+};
 
 vec3 getColor()
 {
@@ -74,7 +82,7 @@ vec3 calculateDirLight(Light light)
     vec3 specular = ks * pow(max(dot(u_ViewDir, reflectDir), 0.0), alpha) * light.color;
 
 	float shadow = 0.0;
-	if (u_ReceiveShadow)
+	if (ReceiveShadow > 0.5)
 	{
 		shadow = calculateShadow(FragPosLightSpace);       
 	}
@@ -2,21 +2,28 @@
 layout (location = 0) in vec3 a_Pos;
 layout (location = 1) in vec3 a_Normal;
 layout (location = 2) in vec2 a_TexCoord;
+// per instance
+layout (location = 3) in mat4 a_Model;
+layout (location = 7) in float a_ReceiveShadow;
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 out vec4 FragPosLightSpace;
+flat out float ReceiveShadow;
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
-uniform mat4 u_LightSpaceMatrix;
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
 
 void main()
 {
 
-    FragPos = vec3(u_Model * vec4(a_Pos, 1.0));
+    FragPos = vec3(a_Model * vec4(a_Pos, 1.0));
     gl_Position = u_Projection * u_View * vec4(FragPos, 1.0);
 
 	//apply nostalgic vertex jitter
@@ -26,6 +33,7 @@ void main()
 
 
     TexCoords = a_TexCoord;
-    Normal = mat3(transpose(inverse(u_Model))) * a_Normal;  
+    Normal = mat3(transpose(inverse(a_Model))) * a_Normal;  
     FragPosLightSpace = u_LightSpaceMatrix * vec4(FragPos, 1.0);
+    ReceiveShadow = a_ReceiveShadow;
 }
\ No newline at end of file
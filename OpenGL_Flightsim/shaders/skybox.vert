@@ -3,12 +3,19 @@ layout (location = 0) in vec3 a_Pos;
 
 out vec3 TexCoords;
 
-uniform mat4 u_Projection;
-uniform mat4 u_View;
 uniform mat4 u_Model;
 
+layout (std140) uniform FrameData {
+	mat4 u_View;
+	mat4 u_Projection;
+	mat4 u_LightSpaceMatrix;
+	vec3 u_CameraPosition;
+	vec3 u_BackgroundColor;
+};
+
 void main()
 {
     TexCoords = a_Pos;
-    gl_Position = u_Projection * u_View * u_Model * vec4(a_Pos, 1.0);
+    // the sky doesn't move with the camera
+    gl_Position = u_Projection * mat4(mat3(u_View)) * u_Model * vec4(a_Pos, 1.0);
 }  
\ No newline at end of file
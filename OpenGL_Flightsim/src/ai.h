@@ -7,6 +7,7 @@
 #include <glm/vec3.hpp>
 
 #include "flightmodel.h"
+#include "pathfinding.h"
 
 glm::vec3 get_intercept_point(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& target_position,
                               const glm::vec3& target_velocity) {
@@ -43,3 +44,41 @@ void fly_towards(Airplane& airplane, const Airplane& target) {
   fly_towards(airplane, point);
 }
 #endif
+
+// flies straight at the target while the terrain allows it, otherwise follows a planned route
+struct Navigator {
+  pathfinding::Planner* planner = nullptr;
+  std::shared_ptr<const pathfinding::Route> route = nullptr;
+
+  void fly_towards(Airplane& airplane, const glm::vec3& target) {
+    const auto position = airplane.rigid_body.position;
+
+    if (planner == nullptr || planner->line_of_sight(position, target)) {
+      route = nullptr;
+      ::fly_towards(airplane, target);
+      return;
+    }
+
+    // keep the previous route until the new one has been planned
+    if (auto planned = planner->get_route(position, target)) {
+      route = planned;
+    }
+
+    if (route == nullptr || !route->found) {
+      // no route (yet), climb and keep heading towards the target
+      ::fly_towards(airplane, glm::vec3(target.x, position.y + planner->params.layer_height, target.z));
+      return;
+    }
+
+    // skip ahead to the furthest waypoint we can reach directly
+    auto waypoint = route->waypoints.front();
+    for (auto it = route->waypoints.rbegin(); it != route->waypoints.rend(); ++it) {
+      if (planner->line_of_sight(position, *it)) {
+        waypoint = *it;
+        break;
+      }
+    }
+
+    ::fly_towards(airplane, waypoint);
+  }
+};
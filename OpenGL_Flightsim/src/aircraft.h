@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "data.h"
+#include "flightmodel.h"
+#include "massproperties.h"
+#include "phi.h"
+
+// airfoils are shared by all aircraft, wings only keep a pointer to them
+const Airfoil NACA_0012(NACA_0012_data);
+const Airfoil NACA_2412(NACA_2412_data);
+const Airfoil NACA_64_206(NACA_64_206_data);
+
+// F-16 like jet used by the player, npcs and headless simulations
+Airplane make_falcon() {
+  const float mass = 7200.0f;  // empty, fuel and stores are added below
+  const float thrust = 50000.0f;
+
+  const float wing_offset = -1.0f;
+  const float tail_offset = -6.6f;
+
+  // uniform density airframe from the model, the hand placed cubes are only used if it can't be loaded
+  static const auto properties = phi::inertia::from_mesh("assets/models/falcon.obj", {1.0f});
+
+  std::vector<phi::inertia::Element> masses = {
+      phi::inertia::cube({wing_offset, 0.0f, -2.7f}, {6.96f, 0.10f, 3.50f}, mass * 0.25f),  // left wing
+      phi::inertia::cube({wing_offset, 0.0f, +2.7f}, {6.96f, 0.10f, 3.50f}, mass * 0.25f),  // right wing
+      phi::inertia::cube({tail_offset, -0.1f, 0.0f}, {6.54f, 0.10f, 2.70f}, mass * 0.1f),   // elevator
+      phi::inertia::cube({tail_offset, 0.0f, 0.0f}, {5.31f, 3.10f, 0.10f}, mass * 0.1f),    // rudder
+      phi::inertia::cube({0.0f, 0.0f, 0.0f}, {8.0f, 2.0f, 2.0f}, mass * 0.5f),              // fuselage
+  };
+
+  // the model's center of gravity sits ahead of the body origin the wings and gear are placed around
+  const bool from_model = properties.mass > 0.0f;
+  const auto inertia =
+      from_model ? phi::inertia::with_mass(properties, mass).tensor : phi::inertia::tensor(masses, true);
+  const auto center_of_gravity = from_model ? properties.center_of_gravity : glm::vec3(0.0f);
+
+  std::vector<Wing> wings = {
+      Wing({wing_offset, 0.0f, -2.7f}, 6.96f, 2.50f, &NACA_64_206),           // left wing
+      Wing({wing_offset - 1.5f, 0.0f, -2.0f}, 3.80f, 1.26f, &NACA_0012),      // left aileron
+      Wing({wing_offset - 1.5f, 0.0f, 2.0f}, 3.80f, 1.26f, &NACA_0012),       // right aileron
+      Wing({wing_offset, 0.0f, +2.7f}, 6.96f, 2.50f, &NACA_64_206),           // right wing
+      Wing({tail_offset, -0.1f, 0.0f}, 6.54f, 2.70f, &NACA_0012),             // elevator
+      Wing({tail_offset, 0.0f, 0.0f}, 5.31f, 3.10f, &NACA_0012, phi::RIGHT),  // rudder
+  };
+
+  Airplane airplane(mass, thrust, inertia, wings, center_of_gravity);
+
+  airplane.gear.wheels = {
+      {.position = {4.8f, -0.9f, 0.0f}, .stiffness = 100000.0f, .damping = 15000.0f},  // nose
+      {.position = {-0.6f, -0.9f, -1.2f}},                                             // left main
+      {.position = {-0.6f, -0.9f, +1.2f}},                                             // right main
+  };
+
+  // internal fuel, the wing tanks run dry first
+  auto& loadout = airplane.loadout;
+  loadout.add_tank({.position = {0.5f, 0.0f, 0.0f}, .capacity = 2200.0f, .fuel = 2200.0f});              // fuselage
+  loadout.add_tank({.position = {-1.0f, 0.0f, -2.0f}, .capacity = 150.0f, .fuel = 150.0f, .order = 1});  // left wing
+  loadout.add_tank({.position = {-1.0f, 0.0f, +2.0f}, .capacity = 150.0f, .fuel = 150.0f, .order = 1});  // right wing
+
+  // short range missiles on the wing tips and the outer pylons
+  const auto missile = phi::inertia::cylinder(0.064f, 2.9f, 85.0f);
+  for (float side : {-1.0f, 1.0f}) {
+    loadout.add_store({.position = {-1.5f, 0.0f, side * 4.7f}, .mass = 85.0f, .inertia = missile});
+    loadout.add_store({.position = {-1.0f, -0.4f, side * 3.6f}, .mass = 85.0f, .inertia = missile});
+  }
+
+  loadout.apply(airplane.rigid_body);
+  return airplane;
+}
@@ -0,0 +1,168 @@
+/*
+    Sweep and prune broadphase, Christer_Ericson-Real-Time_Collision_Detection.pdf#page=329
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <vector>
+
+#include "collisions.h"
+
+namespace collisions {
+
+// axis aligned box that covers a moving sphere for the whole step
+inline AABB get_swept_box(const Sphere& sphere, const glm::vec3& displacement) {
+  const auto min = glm::min(sphere.center, sphere.center + displacement) - glm::vec3(sphere.radius);
+  const auto max = glm::max(sphere.center, sphere.center + displacement) + glm::vec3(sphere.radius);
+  AABB box;
+  box.center = (min + max) * 0.5f, box.size = max - min;
+  return box;
+}
+
+// boxes are sorted along one axis by their end points. objects move only a little between steps, so the
+// end points stay almost sorted and an insertion sort restores the order in close to linear time.
+class SweepAndPrune {
+ public:
+  struct Pair {
+    int a, b;  // proxy ids, a < b
+  };
+
+  SweepAndPrune(int sweep_axis = 0) : axis(sweep_axis) { assert(0 <= axis && axis < 3); }
+
+  // proxies only report pairs with proxies whose layer is in their mask (or the other way around)
+  int add(const AABB& box, uint32_t layer = 1U, uint32_t mask = ~0U) {
+    int id;
+    if (!m_free.empty()) {
+      id = m_free.back();
+      m_free.pop_back();
+    } else {
+      id = static_cast<int>(m_proxies.size());
+      m_proxies.emplace_back();
+    }
+
+    auto& proxy = m_proxies[id];
+    proxy.min = box.min(), proxy.max = box.max();
+    proxy.layer = layer, proxy.mask = mask;
+    proxy.active = true;
+
+    // new end points go to the back, the next sort moves them into place
+    m_endpoints.push_back({proxy.min[axis], id, true});
+    m_endpoints.push_back({proxy.max[axis], id, false});
+    return id;
+  }
+
+  // the end points are dropped by the next find_pairs, the id is only reused after that
+  void remove(int id) {
+    assert(m_proxies[id].active);
+    m_proxies[id].active = false;
+    m_removed.push_back(id);
+  }
+
+  void update(int id, const AABB& box) {
+    auto& proxy = m_proxies[id];
+    assert(proxy.active);
+    proxy.min = box.min(), proxy.max = box.max();
+  }
+
+  // track a sphere that moves by displacement during the step
+  inline void update(int id, const Sphere& sphere, const glm::vec3& displacement) {
+    update(id, get_swept_box(sphere, displacement));
+  }
+
+  // sort the end points and collect all pairs of overlapping boxes
+  const std::vector<Pair>& find_pairs() {
+    if (!m_removed.empty()) {
+      std::erase_if(m_endpoints, [this](const Endpoint& endpoint) { return !m_proxies[endpoint.id].active; });
+      m_free.insert(m_free.end(), m_removed.begin(), m_removed.end());
+      m_removed.clear();
+    }
+
+    for (auto& endpoint : m_endpoints) {
+      const auto& proxy = m_proxies[endpoint.id];
+      endpoint.value = endpoint.is_min ? proxy.min[axis] : proxy.max[axis];
+    }
+
+    insertion_sort();
+
+    m_pairs.clear();
+    m_open.clear();
+
+    for (const auto& endpoint : m_endpoints) {
+      if (!endpoint.is_min) {
+        // box ends, remove it from the open set
+        auto it = std::find(m_open.begin(), m_open.end(), endpoint.id);
+        *it = m_open.back();
+        m_open.pop_back();
+        continue;
+      }
+
+      const auto& proxy = m_proxies[endpoint.id];
+
+      // every open box overlaps on the sweep axis, test the other two
+      for (int other_id : m_open) {
+        const auto& other = m_proxies[other_id];
+
+        if (!(proxy.layer & other.mask) && !(other.layer & proxy.mask)) continue;
+        if (!overlaps(proxy, other)) continue;
+
+        m_pairs.push_back({std::min(endpoint.id, other_id), std::max(endpoint.id, other_id)});
+      }
+
+      m_open.push_back(endpoint.id);
+    }
+
+    return m_pairs;
+  }
+
+  inline const std::vector<Pair>& get_pairs() const { return m_pairs; }
+
+  const int axis;
+
+ private:
+  struct Proxy {
+    glm::vec3 min{}, max{};
+    uint32_t layer = 1U, mask = ~0U;
+    bool active = false;
+  };
+
+  struct Endpoint {
+    float value;
+    int id;
+    bool is_min;
+
+    // min end points go first so touching boxes are reported
+    inline bool operator<(const Endpoint& other) const {
+      return value < other.value || (value == other.value && is_min && !other.is_min);
+    }
+  };
+
+  std::vector<Proxy> m_proxies;
+  std::vector<Endpoint> m_endpoints;
+  std::vector<int> m_free, m_removed;
+  std::vector<int> m_open;
+  std::vector<Pair> m_pairs;
+
+  void insertion_sort() {
+    for (size_t i = 1; i < m_endpoints.size(); i++) {
+      const Endpoint endpoint = m_endpoints[i];
+      size_t j = i;
+
+      for (; j > 0 && endpoint < m_endpoints[j - 1]; j--) {
+        m_endpoints[j] = m_endpoints[j - 1];
+      }
+      m_endpoints[j] = endpoint;
+    }
+  }
+
+  inline bool overlaps(const Proxy& a, const Proxy& b) const {
+    for (int i = 0; i < 3; i++) {
+      if (i == axis) continue;
+      if (a.max[i] < b.min[i] || a.min[i] > b.max[i]) return false;
+    }
+    return true;
+  }
+};
+};  // namespace collisions
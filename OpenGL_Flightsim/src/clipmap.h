@@ -1,16 +1,46 @@
 #pragma once
 
+#include <memory>
+
 #include "gfx.h"
+#include "terrain.h"
+#include "terraintiles.h"
 
 constexpr unsigned int primitive_restart = 0xFFFFU;
 const std::string path = "assets/textures/terrain/1/";
 
+// placement of one piece of the clipmap, the vertex shader applies it per instance
+struct PieceInstance {
+  glm::vec2 offset;  // x and z in world space
+  float scale;
+  float angle;  // about the y axis, radians
+  float level;  // 0 - 1, only used for debug colors
+};
+
+// point the instance attributes of a piece at the buffer the instances are streamed to
+inline void set_instance_buffer(gfx::gl::VertexArrayObject& vao, const gfx::gl::VertexBuffer& buffer) {
+  vao.bind();
+  buffer.bind();
+
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(PieceInstance), (void*)offsetof(PieceInstance, offset));
+  glEnableVertexAttribArray(1);
+  glVertexAttribDivisor(1, 1);
+
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(PieceInstance), (void*)offsetof(PieceInstance, level));
+  glEnableVertexAttribArray(2);
+  glVertexAttribDivisor(2, 1);
+
+  vao.unbind();
+  buffer.unbind();
+}
+
 struct Seam {
   gfx::gl::VertexBuffer vbo;
   gfx::gl::VertexArrayObject vao;
   unsigned int index_count;
+  glm::vec2 extent;  // on x and z in model space
 
-  Seam(int columns, float size) {
+  Seam(int columns, float size) : extent(columns * size, 0.0f) {
     int rows = 1;
     index_count = columns;
 
@@ -42,6 +72,12 @@ struct Seam {
     glDrawArrays(GL_TRIANGLES, 0, 3 * index_count);
     unbind();
   }
+
+  void draw_instanced(int first, int count) {
+    bind();
+    glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 3 * index_count, count, first);
+    unbind();
+  }
 };
 
 struct Block {
@@ -49,8 +85,9 @@ struct Block {
   gfx::gl::ElementBufferObject ebo;
   gfx::gl::VertexArrayObject vao;
   unsigned int index_count;
+  glm::vec2 extent;  // on x and z in model space
 
-  Block(int width, int height, float segment_size) {
+  Block(int width, int height, float segment_size) : extent(height * segment_size, width * segment_size) {
 #if 1
     std::vector<glm::vec3> vertices;
     std::vector<unsigned int> indices;
@@ -97,6 +134,185 @@ struct Block {
     glDrawElements(GL_TRIANGLE_STRIP, index_count, GL_UNSIGNED_INT, 0);
     unbind();
   }
+
+  void draw_instanced(int first, int count) {
+    bind();
+    glDrawElementsInstancedBaseInstance(GL_TRIANGLE_STRIP, index_count, GL_UNSIGNED_INT, 0, count, first);
+    unbind();
+  }
+};
+
+// one toroidal texture array per layer with a window of every level of the tile pyramid around the camera. tiles that
+// come into view are read by the loader thread and copied over the slots of the tiles that left on the other side.
+// a level is only sampled where all of its tiles are resident, the shaders fall back to coarser levels elsewhere
+class ClipTextures {
+ public:
+  static constexpr int MAX_LEVELS = 8;  // keep in sync with clipmap.vert and clipmap.frag
+
+  // size is the width of a window in texels, a multiple of the tile size
+  ClipTextures(std::shared_ptr<const terrain::TileSource> source, int size = 512, int max_uploads = 8)
+      : m_loader(source),
+        m_size(size),
+        m_tiles_per_side(size / source->get_tile_size()),
+        m_max_uploads(max_uploads) {
+    assert(size % source->get_tile_size() == 0);
+
+    // up to the first level that fits into half a window, which then always has the whole terrain
+    int levels = 1;
+    while (levels < std::min(MAX_LEVELS, source->get_levels()) &&
+           glm::max(source->get_size(levels - 1).x, source->get_size(levels - 1).y) > size / 2) {
+      levels++;
+    }
+    m_levels.resize(levels);
+
+    for (auto& level : m_levels) {
+      level.slots.resize(static_cast<size_t>(m_tiles_per_side) * m_tiles_per_side, {-1, 0, 0});
+      level.resident.resize(level.slots.size(), 0);
+    }
+
+    const GLint filters[terrain::LAYER_COUNT] = {GL_LINEAR, GL_LINEAR, GL_NEAREST};
+    for (int l = 0; l < terrain::LAYER_COUNT; l++) {
+      const auto& format = terrain::LAYER_FORMATS[l];
+      m_textures[l] = std::make_unique<gfx::gl::TextureArray>(
+          size, size, levels, get_internal_format(format),
+          gfx::gl::TextureParams{.texture_min_filter = GL_LINEAR, .texture_mag_filter = filters[l]});
+    }
+  }
+
+  // move the windows so they are centered around uv, request the tiles that came into view and upload some that
+  // have been read
+  void update(const glm::vec2& uv) {
+    bool moved = false;
+    for (int l = 0; l < static_cast<int>(m_levels.size()); l++) moved |= move_window(l, uv);
+
+    if (moved) m_loader.cancel_if([this](const terrain::TileKey& key) { return !is_pending(key); });
+
+    m_uploads.clear();
+    m_loader.poll(m_uploads, m_max_uploads);
+    for (const auto& tile : m_uploads) upload(tile);
+  }
+
+  // samplers on first_unit and the following units, the shader has to be bound
+  void bind(gfx::gl::Shader& shader, GLuint first_unit) const {
+    const auto& source = m_loader.get_source();
+    const int tile_size = source.get_tile_size();
+    glm::vec4 valid[MAX_LEVELS], scale[MAX_LEVELS];
+
+    for (int l = 0; l < static_cast<int>(m_levels.size()); l++) {
+      const auto& level = m_levels[l];
+      const glm::vec2 size(source.get_size(l));
+
+      // in uv, a texel away from the edges so the filtered texels are resident too
+      valid[l] = glm::vec4(glm::vec2(level.valid_min * tile_size + 1) / size,
+                           glm::vec2(level.valid_max * tile_size - 1) / size);
+      scale[l] = glm::vec4(size / static_cast<float>(m_size), 0.0f, 0.0f);
+    }
+
+    const char* samplers[terrain::LAYER_COUNT] = {"u_ClipHeight", "u_ClipNormal", "u_ClipAlbedo"};
+    for (int l = 0; l < terrain::LAYER_COUNT; l++) {
+      m_textures[l]->bind(first_unit + l);
+      shader.uniform(samplers[l], static_cast<int>(first_unit + l));
+    }
+
+    shader.uniform("u_ClipValid", valid, static_cast<int>(m_levels.size()));
+    shader.uniform("u_ClipScale", scale, static_cast<int>(m_levels.size()));
+    shader.uniform("u_ClipLevels", static_cast<int>(m_levels.size()));
+  }
+
+ private:
+  // window of a level and the tile every slot of its texture holds or waits for
+  struct Level {
+    bool placed = false;
+    glm::ivec2 origin{0};                   // first tile of the window
+    glm::ivec2 valid_min{0}, valid_max{0};  // resident tiles, max is exclusive
+    std::vector<terrain::TileKey> slots;    // row major, tile (x, y) goes to slot (x, y) mod tiles per side
+    std::vector<uint8_t> resident;
+    int pending = 0;
+  };
+
+  terrain::TileLoader m_loader;
+  std::unique_ptr<gfx::gl::TextureArray> m_textures[terrain::LAYER_COUNT];
+  std::vector<Level> m_levels;
+  std::vector<terrain::Tile> m_uploads;
+  const int m_size;
+  const int m_tiles_per_side;
+  const int m_max_uploads;
+
+  static GLint get_internal_format(const terrain::LayerFormat& format) {
+    if (format.bytes == 2) return format.channels == 1 ? GL_R16 : GL_RGB16;
+    return format.channels == 1 ? GL_R8 : GL_RGB8;
+  }
+
+  inline size_t get_slot(const terrain::TileKey& key) const {
+    auto wrap = [this](int i) { return ((i % m_tiles_per_side) + m_tiles_per_side) % m_tiles_per_side; };
+    return static_cast<size_t>(wrap(key.y)) * m_tiles_per_side + wrap(key.x);
+  }
+
+  inline bool is_pending(const terrain::TileKey& key) const {
+    const auto& level = m_levels[key.level];
+    const size_t slot = get_slot(key);
+    return level.slots[slot] == key && !level.resident[slot];
+  }
+
+  // returns true if the window moved. the first window of the coarsest level is read right away so there is always
+  // something to fall back to
+  bool move_window(int l, const glm::vec2& uv) {
+    auto& level = m_levels[l];
+    const auto& source = m_loader.get_source();
+    const int tile_size = source.get_tile_size();
+
+    const glm::vec2 texel = uv * glm::vec2(source.get_size(l));
+    const glm::ivec2 origin = glm::ivec2(glm::floor(texel / static_cast<float>(tile_size))) - m_tiles_per_side / 2;
+    if (level.placed && origin == level.origin) return false;
+
+    const bool first = !level.placed;
+    level.placed = true, level.origin = origin;
+
+    // tiles that are still in the window keep their slots
+    level.valid_min = glm::max(level.valid_min, origin);
+    level.valid_max = glm::max(level.valid_min, glm::min(level.valid_max, origin + m_tiles_per_side));
+
+    for (int y = origin.y; y < origin.y + m_tiles_per_side; y++) {
+      for (int x = origin.x; x < origin.x + m_tiles_per_side; x++) {
+        const terrain::TileKey key{l, x, y};
+        const size_t slot = get_slot(key);
+        if (level.slots[slot] == key) continue;
+
+        if (level.resident[slot]) level.resident[slot] = 0, level.pending++;
+        if (level.slots[slot].level < 0) level.pending++;
+        level.slots[slot] = key;
+
+        if (first && l + 1 == static_cast<int>(m_levels.size())) {
+          terrain::Tile tile;
+          source.read(key, tile);
+          upload(tile);
+        } else {
+          m_loader.request(key);
+        }
+      }
+    }
+    return true;
+  }
+
+  // tiles that left the window while they were read are dropped
+  void upload(const terrain::Tile& tile) {
+    if (!is_pending(tile.key)) return;
+
+    auto& level = m_levels[tile.key.level];
+    const int tile_size = m_loader.get_source().get_tile_size();
+    const size_t slot = get_slot(tile.key);
+    const int x = static_cast<int>(slot % m_tiles_per_side) * tile_size;
+    const int y = static_cast<int>(slot / m_tiles_per_side) * tile_size;
+
+    for (int l = 0; l < terrain::LAYER_COUNT; l++) {
+      const auto& format = terrain::LAYER_FORMATS[l];
+      m_textures[l]->update(tile.key.level, x, y, tile_size, tile_size, format.channels == 1 ? GL_RED : GL_RGB,
+                            format.bytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE, tile.layers[l]);
+    }
+
+    level.resident[slot] = 1;
+    if (--level.pending == 0) level.valid_min = level.origin, level.valid_max = level.origin + m_tiles_per_side;
+  }
 };
 
 class Clipmap : public gfx::Object3D {
@@ -105,9 +321,10 @@ class Clipmap : public gfx::Object3D {
 
   Clipmap(int levels = 16, int segments = 32, float segment_size = 2.0f)
       : shader("shaders/clipmap"),
-        heightmap(path + "heightmap.png", {.texture_mag_filter = GL_LINEAR}),
-        normalmap(path + "normalmap.png", {.texture_mag_filter = GL_LINEAR}),
-        terrain(path + "terrain.png", {.texture_mag_filter = GL_NEAREST}),
+        tiles(terrain::load_tiles(path + "terrain.tiles", path + "heightmap.png", path + "normalmap.png",
+                                  path + "terrain.png")),
+        textures(tiles),
+        field(tiles),
         levels(levels),
         segments(segments),
         segment_size(segment_size),
@@ -117,148 +334,67 @@ class Clipmap : public gfx::Object3D {
         horizontal(2 * segments + 2, 1, segment_size),
         vertical(1, 2 * segments + 2, segment_size),
         center(2 * segments + 2, 2 * segments + 2, segment_size),
-        seam(2 * segments + 2, segment_size * 2) {}
-
-  float get_terrain_height(glm::vec2 coords) { return 0.0f; }
-
-  void draw_self(gfx::RenderContext& context) override {
-#if 1
-    if (!context.is_shadow_pass) {
-      auto camera_pos = context.camera->get_world_position();
-      float height = camera_pos.y;
-      auto camera_pos_xy = glm::vec2(camera_pos.x, camera_pos.z);
-
-      heightmap.bind(2);
-      normalmap.bind(3);
-      terrain.bind(4);
-
-      shader.bind();
-      shader.uniform("u_Heightmap", 2);
-      shader.uniform("u_Normalmap", 3);
-      shader.uniform("u_Texture", 4);
-      shader.uniform("u_Background", context.background_color);
-      shader.uniform("u_View", context.camera->get_view_matrix());
-      shader.uniform("u_CameraPos", context.camera->get_world_position());
-      shader.uniform("u_Projection", context.camera->get_projection_matrix());
-
-      glEnable(GL_CULL_FACE);
-      glEnable(GL_PRIMITIVE_RESTART);
-      glPrimitiveRestartIndex(primitive_restart);
-      if (wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-      int min_level = 1;  // should depend on camera height
-
-      for (int l = min_level; l <= levels; l++) {
-        const int rows = 5, cols = 5;
-        // float border = 0.0f;
-        float scale = std::pow(2.0f, l);
-        float next_scale = std::pow(2.0f, l + 2);
-        float scaled_segment_size = segment_size * scale;
-        float tile_size = segments * scaled_segment_size;
-        glm::vec2 snapped = glm::floor(camera_pos_xy / next_scale) * next_scale;
-        auto base = calc_base(l, camera_pos_xy);
-
-        shader.uniform("u_Scale", scale);
-        shader.uniform("u_SegmentSize", scaled_segment_size);
-        shader.uniform("u_Level", static_cast<float>(l) / levels);
+        seam(2 * segments + 2, segment_size * 2) {
+    for (auto* vao : {&tile.vao, &center.vao, &col_fixup.vao, &row_fixup.vao, &horizontal.vao, &vertical.vao,
+                      &seam.vao}) {
+      set_instance_buffer(*vao, instance_buffer);
+    }
+  }
 
-#if 1
-        // don't render lots of detail if we are very high up
-        if (tile_size * 5 < height * 2.5) {
-          min_level = l + 1;
-          continue;
-        }
-#endif
-#if 1
-        if (l == min_level) {
-          shader.uniform("u_Model", transform_matrix(base + glm::vec2(tile_size, tile_size), scale));
-          center.draw();
-        } else {
-          auto prev_base = calc_base(l - 1, camera_pos_xy);
-          auto diff = glm::abs(base - prev_base);
+  float get_terrain_height(glm::vec2 coords) const { return field.get_height(coords); }
 
-          auto l_offset = glm::vec2(tile_size, tile_size);
-          if (diff.x == tile_size) {
-            l_offset.x += (2 * segments + 1) * scaled_segment_size;
-          }
-          shader.uniform("u_Model", transform_matrix(base + l_offset, scale));
-          horizontal.draw();
+  const terrain::TerrainField& get_terrain() const { return field; }
 
-          auto v_offset = glm::vec2(tile_size, tile_size);
-          if (diff.y == tile_size) {
-            v_offset.y += (2 * segments + 1) * scaled_segment_size;
-          }
+  void enqueue(gfx::RenderQueue& queue, const gfx::RenderContext& context) override {
+    if (!context.is_shadow_pass) queue.push(this, gfx::RenderPass::OPAQUE, {}, 0.0f);
+  }
 
-          shader.uniform("u_Model", transform_matrix(base + v_offset, scale));
-          vertical.draw();
-        }
-#endif
+  // every piece of every level is drawn with one instanced call per kind of piece
+  void draw_self(gfx::RenderContext& context) override {
+    if (context.is_shadow_pass) return;
+
+    const auto camera_pos = context.camera->get_world_position();
+    const gfx::Frustum frustum(context.camera->get_projection_matrix() * context.camera->get_view_matrix());
+    place_pieces(camera_pos, &frustum);
+    textures.update(field.get_uv(glm::vec2(camera_pos.x, camera_pos.z)));
+
+    instances.clear();
+    int first[PIECE_COUNT];
+    for (int p = 0; p < PIECE_COUNT; p++) {
+      first[p] = static_cast<int>(instances.size());
+      instances.insert(instances.end(), pieces[p].begin(), pieces[p].end());
+    }
+    if (instances.empty()) return;
+    instance_buffer.buffer(instances, GL_STREAM_DRAW);
 
-        glm::vec2 offset(0.0f);
-        for (int r = 0; r < rows; r++) {
-          offset.y = 0;
-          for (int c = 0; c < cols; c++) {
-            if (r == 0 || r == rows - 1 || c == 0 || c == cols - 1) {
-              auto tile_pos = base + offset;
-              shader.uniform("u_Model", transform_matrix(tile_pos, scale));
-
-              if ((c != 2) && (r != 2)) {
-                if (c == 0 && r == 0)  // east
-                {
-                  shader.uniform("u_Model", transform_matrix(tile_pos, scale));
-                  seam.draw();
-                } else if (c == cols - 1 && r == rows - 1)  // west
-                {
-                  shader.uniform("u_Model", transform_matrix(tile_pos + glm::vec2(tile_size), scale, 180.0f));
-                  seam.draw();
-                } else if (c == cols - 1 && r == 0)  // south
-                {
-                  shader.uniform("u_Model", transform_matrix(tile_pos + glm::vec2(0, tile_size), scale, 90.0f));
-                  seam.draw();
-                } else if (c == 0 && r == rows - 1)  // north
-                {
-                  shader.uniform("u_Model", transform_matrix(tile_pos + glm::vec2(tile_size, 0), scale, -90.0f));
-                  seam.draw();
-                }
-
-                shader.uniform("u_Model", transform_matrix(tile_pos, scale));
-                tile.draw();
-              } else if (c == 2) {
-                col_fixup.draw();
-              } else if (r == 2) {
-                row_fixup.draw();
-              }
-            }
+    shader.bind();
+    textures.bind(shader, 2);
 
-            if (c == 2) {
-              offset.y += 2 * scaled_segment_size;
-            } else {
-              offset.y += tile_size;
-            }
-          }
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(primitive_restart);
+    if (wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-          if (r == 2) {
-            offset.x += 2 * scaled_segment_size;
-          } else {
-            offset.x += tile_size;
-          }
-        }
-      }
+    Block* blocks[] = {&tile, &center, &col_fixup, &row_fixup, &horizontal, &vertical};
+    for (int p = TILE; p <= VERTICAL; p++) {
+      if (!pieces[p].empty()) blocks[p]->draw_instanced(first[p], static_cast<int>(pieces[p].size()));
+    }
+    if (!pieces[SEAM].empty()) seam.draw_instanced(first[SEAM], static_cast<int>(pieces[SEAM].size()));
 
-      if (wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    if (wireframe) glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-      glDisable(GL_CULL_FACE);
+    glDisable(GL_CULL_FACE);
 
-      shader.unbind();
-    }
-#endif
+    shader.unbind();
   }
 
  private:
+  enum Piece { TILE, CENTER, COL_FIXUP, ROW_FIXUP, HORIZONTAL, VERTICAL, SEAM, PIECE_COUNT };
+
   gfx::gl::Shader shader;
-  gfx::gl::Texture heightmap;
-  gfx::gl::Texture normalmap;
-  gfx::gl::Texture terrain;
+  std::shared_ptr<const terrain::TileSource> tiles;  // shared by the textures and the cpu queries
+  ClipTextures textures;
+  terrain::TerrainField field;
 
   Block tile;
   Block center;
@@ -268,6 +404,10 @@ class Clipmap : public gfx::Object3D {
   Block vertical;
   Seam seam;
 
+  std::vector<PieceInstance> pieces[PIECE_COUNT];  // of this frame, by kind
+  std::vector<PieceInstance> instances;            // all pieces in the order they are drawn
+  gfx::gl::VertexBuffer instance_buffer;
+
   unsigned index_count = 0;
   const int levels;
   const int segments;
@@ -282,10 +422,112 @@ class Clipmap : public gfx::Object3D {
     return base;
   }
 
-  glm::mat4 transform_matrix(const glm::vec2& position, float scale, float angle = 0) {
-    auto S = glm::scale(glm::mat4(1.0f), glm::vec3(scale));
-    auto T = glm::translate(glm::mat4(1.0f), glm::vec3(position.x, 0.0f, position.y));
-    auto R = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-    return T * R * S;
+  // box around the heights under the rotated and scaled extent of a piece
+  bool is_visible(const PieceInstance& instance, const glm::vec2& extent, const gfx::Frustum& frustum) const {
+    const float s = std::sin(instance.angle), c = std::cos(instance.angle);
+    glm::vec2 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+
+    for (const auto& corner : {glm::vec2(0.0f), glm::vec2(extent.x, 0.0f), glm::vec2(0.0f, extent.y), extent}) {
+      const auto p = corner * instance.scale;
+      const auto q = instance.offset + glm::vec2(c * p.x + s * p.y, -s * p.x + c * p.y);
+      min = glm::min(min, q), max = glm::max(max, q);
+    }
+
+    const auto heights = field.get_height_range(min, max);
+    return frustum.test(glm::vec3(min.x, heights.x, min.y), glm::vec3(max.x, heights.y, max.y));
+  }
+
+  // ring of tiles around the finer levels, with fixups in the middle of the ring, trims between the levels and seams
+  // at the corners. pieces whose bounds are outside of the frustum are left out if there is one
+  void place_pieces(const glm::vec3& camera_pos, const gfx::Frustum* frustum = nullptr) {
+    const glm::vec2 extents[PIECE_COUNT] = {tile.extent,       center.extent,   col_fixup.extent, row_fixup.extent,
+                                            horizontal.extent, vertical.extent, seam.extent};
+
+    for (auto& piece : pieces) piece.clear();
+
+    float height = camera_pos.y;
+    auto camera_pos_xy = glm::vec2(camera_pos.x, camera_pos.z);
+
+    int min_level = 1;  // should depend on camera height
+
+    for (int l = min_level; l <= levels; l++) {
+      const int rows = 5, cols = 5;
+      float scale = std::pow(2.0f, l);
+      float scaled_segment_size = segment_size * scale;
+      float tile_size = segments * scaled_segment_size;
+      auto base = calc_base(l, camera_pos_xy);
+      const float level = static_cast<float>(l) / levels;
+
+      auto place = [&](Piece piece, const glm::vec2& position, float angle = 0.0f) {
+        const PieceInstance instance{position, scale, glm::radians(angle), level};
+        if (frustum && !is_visible(instance, extents[piece], *frustum)) return;
+        pieces[piece].push_back(instance);
+      };
+
+      // don't render lots of detail if we are very high up
+      if (tile_size * 5 < height * 2.5) {
+        min_level = l + 1;
+        continue;
+      }
+
+      if (l == min_level) {
+        place(CENTER, base + glm::vec2(tile_size, tile_size));
+      } else {
+        auto prev_base = calc_base(l - 1, camera_pos_xy);
+        auto diff = glm::abs(base - prev_base);
+
+        auto l_offset = glm::vec2(tile_size, tile_size);
+        if (diff.x == tile_size) {
+          l_offset.x += (2 * segments + 1) * scaled_segment_size;
+        }
+        place(HORIZONTAL, base + l_offset);
+
+        auto v_offset = glm::vec2(tile_size, tile_size);
+        if (diff.y == tile_size) {
+          v_offset.y += (2 * segments + 1) * scaled_segment_size;
+        }
+        place(VERTICAL, base + v_offset);
+      }
+
+      glm::vec2 offset(0.0f);
+      for (int r = 0; r < rows; r++) {
+        offset.y = 0;
+        for (int c = 0; c < cols; c++) {
+          if (r == 0 || r == rows - 1 || c == 0 || c == cols - 1) {
+            auto tile_pos = base + offset;
+
+            if ((c != 2) && (r != 2)) {
+              if (c == 0 && r == 0) {  // east
+                place(SEAM, tile_pos);
+              } else if (c == cols - 1 && r == rows - 1) {  // west
+                place(SEAM, tile_pos + glm::vec2(tile_size), 180.0f);
+              } else if (c == cols - 1 && r == 0) {  // south
+                place(SEAM, tile_pos + glm::vec2(0, tile_size), 90.0f);
+              } else if (c == 0 && r == rows - 1) {  // north
+                place(SEAM, tile_pos + glm::vec2(tile_size, 0), -90.0f);
+              }
+
+              place(TILE, tile_pos);
+            } else if (c == 2) {
+              place(COL_FIXUP, tile_pos);
+            } else if (r == 2) {
+              place(ROW_FIXUP, tile_pos);
+            }
+          }
+
+          if (c == 2) {
+            offset.y += 2 * scaled_segment_size;
+          } else {
+            offset.y += tile_size;
+          }
+        }
+
+        if (r == 2) {
+          offset.x += 2 * scaled_segment_size;
+        } else {
+          offset.x += tile_size;
+        }
+      }
+    }
   }
 };
\ No newline at end of file
@@ -3,14 +3,19 @@
 */
 #pragma once
 
+#include <cstdint>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/gtx/vector_angle.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
+#include <limits>
 #include <tuple>
 
+#include "simd.h"
+
 #define RUN_COLLISION_UNITTESTS 0
+#define RUN_COLLISION_BENCHMARKS 0
 
 namespace collisions {
 
@@ -50,7 +55,7 @@ struct Ray : public Collider {
 // test collision between a ray and a sphere
 bool test_collision(const Ray& r, const Sphere& s, float* t) {
   // page 178
-  assert(std::abs(glm::length(r.direction) - 1.0f) < EPSILON);
+  assert(std::abs(glm::length(r.direction) - 1.0f) < 1e-5f);  // normalized directions are only accurate to ~1e-7
 
   auto m = r.origin - s.center;
   auto b = glm::dot(m, r.direction);
@@ -75,8 +80,9 @@ bool test_collision(const Sphere& s0, const Sphere& s1) {
 bool test_collision(const AABB& a, const AABB& b) {
   auto a_min = a.min(), a_max = a.max();
   auto b_min = b.min(), b_max = b.max();
-  return ((a_max.x < b_min.x || a_min.x > b_max.x) && (a_max.y < b_min.y || a_min.y > b_max.y) &&
-          (a_max.z < b_min.z || a_min.z > b_max.z));
+  // boxes overlap unless they are separated on at least one axis
+  return !((a_max.x < b_min.x || a_min.x > b_max.x) || (a_max.y < b_min.y || a_min.y > b_max.y) ||
+           (a_max.z < b_min.z || a_min.z > b_max.z));
 }
 
 // test collision of two moving spheres
@@ -117,6 +123,12 @@ bool test_moving_collision(const Sphere& s0, const glm::vec3& velocity0, const S
   auto v = velocity0 - velocity1;
   auto vlen = glm::length(v);
 
+  // not moving relative to each other, only an existing overlap counts
+  if (vlen < EPSILON) {
+    *t = 0.0f;
+    return test_collision(s0, s1);
+  }
+
   Ray ray = {.origin = s0.center, .direction = v / vlen};
   Sphere sphere = {.center = s1.center, .radius = s0.radius + s1.radius};
 
@@ -126,4 +138,198 @@ bool test_moving_collision(const Sphere& s0, const glm::vec3& velocity0, const S
     return false;
 #endif
 }
+
+// structure of arrays views for the batch tests, every pointer points to at least `count` floats
+struct Vec3Batch {
+  const float *x, *y, *z;
+};
+
+struct SphereBatch {
+  Vec3Batch center;
+  const float* radius;
+};
+
+struct RayBatch {
+  Vec3Batch origin, direction;  // directions have to be normalized
+};
+
+struct AABBBatch {
+  Vec3Batch min, max;
+};
+
+namespace batch {
+inline glm::vec3 load(const Vec3Batch& v, int i) { return {v.x[i], v.y[i], v.z[i]}; }
+
+inline Sphere load(const SphereBatch& s, int i) {
+  Sphere sphere;
+  sphere.center = load(s.center, i), sphere.radius = s.radius[i];
+  return sphere;
+}
+
+inline Ray load(const RayBatch& r, int i) {
+  Ray ray;
+  ray.origin = load(r.origin, i), ray.direction = load(r.direction, i);
+  return ray;
+}
+
+inline AABB load(const AABBBatch& b, int i) {
+  AABB box;
+  box.center = (load(b.min, i) + load(b.max, i)) * 0.5f, box.size = load(b.max, i) - load(b.min, i);
+  return box;
+}
+
+#if SIMD_SSE2
+struct Vec3x4 {
+  __m128 x, y, z;
+};
+
+inline Vec3x4 load4(const Vec3Batch& v, int i) {
+  return {_mm_loadu_ps(v.x + i), _mm_loadu_ps(v.y + i), _mm_loadu_ps(v.z + i)};
+}
+
+inline Vec3x4 sub4(const Vec3x4& a, const Vec3x4& b) {
+  return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+}
+
+inline Vec3x4 div4(const Vec3x4& a, __m128 s) { return {_mm_div_ps(a.x, s), _mm_div_ps(a.y, s), _mm_div_ps(a.z, s)}; }
+
+// same order of operations as glm::dot so results match the scalar tests
+inline __m128 dot4(const Vec3x4& a, const Vec3x4& b) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+// write one byte per lane of a 4 bit mask and return the number of set bits
+inline int store_hits(int bits, uint8_t* hits) {
+  int count = 0;
+  for (int k = 0; k < 4; k++) count += (hits[k] = static_cast<uint8_t>((bits >> k) & 1));
+  return count;
+}
+
+// ray against sphere for 4 lanes, page 178
+inline __m128 ray_sphere4(const Vec3x4& origin, const Vec3x4& direction, const Vec3x4& center, __m128 radius,
+                          __m128* t) {
+  const __m128 zero = _mm_setzero_ps();
+  auto m = sub4(origin, center);
+  auto b = dot4(m, direction);
+  auto c = _mm_sub_ps(dot4(m, m), _mm_mul_ps(radius, radius));
+  auto discr = _mm_sub_ps(_mm_mul_ps(b, b), c);
+
+  auto outside_and_away = _mm_and_ps(_mm_cmpgt_ps(c, zero), _mm_cmpgt_ps(b, zero));
+  auto hit = _mm_andnot_ps(_mm_or_ps(outside_and_away, _mm_cmplt_ps(discr, zero)), _mm_cmpeq_ps(zero, zero));
+
+  *t = _mm_max_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discr, zero))), zero);
+  return hit;
+}
+#endif
+};  // namespace batch
+
+// the batch tests compare element i of the first batch with element i of the second batch (e.g. the pairs
+// gathered by the broadphase), write 1 to hits[i] on a collision and 0 otherwise and return the number of hits.
+// t[i] is set to std::numeric_limits<float>::max() for misses
+
+// test collisions between pairs of spheres
+int test_collision(const SphereBatch& s0, const SphereBatch& s1, int count, uint8_t* hits) {
+  int i = 0, total = 0;
+#if SIMD_SSE2
+  for (; i + 4 <= count; i += 4) {
+    auto delta = batch::sub4(batch::load4(s0.center, i), batch::load4(s1.center, i));
+    auto distance = _mm_sqrt_ps(batch::dot4(delta, delta));
+    auto radius = _mm_add_ps(_mm_loadu_ps(s0.radius + i), _mm_loadu_ps(s1.radius + i));
+    total += batch::store_hits(_mm_movemask_ps(_mm_cmplt_ps(distance, radius)), hits + i);
+  }
+#endif
+  for (; i < count; i++) {
+    total += (hits[i] = test_collision(batch::load(s0, i), batch::load(s1, i)));
+  }
+  return total;
+}
+
+// test collisions between pairs of rays and spheres
+int test_collision(const RayBatch& r, const SphereBatch& s, int count, float* t, uint8_t* hits) {
+  int i = 0, total = 0;
+#if SIMD_SSE2
+  const __m128 miss = _mm_set1_ps(std::numeric_limits<float>::max());
+
+  for (; i + 4 <= count; i += 4) {
+    __m128 distance;
+    auto hit = batch::ray_sphere4(batch::load4(r.origin, i), batch::load4(r.direction, i),
+                                  batch::load4(s.center, i), _mm_loadu_ps(s.radius + i), &distance);
+    _mm_storeu_ps(t + i, simd::select(hit, distance, miss));
+    total += batch::store_hits(_mm_movemask_ps(hit), hits + i);
+  }
+#endif
+  for (; i < count; i++) {
+    hits[i] = test_collision(batch::load(r, i), batch::load(s, i), &t[i]);
+    if (!hits[i]) t[i] = std::numeric_limits<float>::max();
+    total += hits[i];
+  }
+  return total;
+}
+
+// test collisions between pairs of axis aligned bounding boxes
+int test_collision(const AABBBatch& a, const AABBBatch& b, int count, uint8_t* hits) {
+  int i = 0, total = 0;
+#if SIMD_SSE2
+  for (; i + 4 <= count; i += 4) {
+    auto a_min = batch::load4(a.min, i), a_max = batch::load4(a.max, i);
+    auto b_min = batch::load4(b.min, i), b_max = batch::load4(b.max, i);
+
+    auto separated = _mm_or_ps(_mm_cmplt_ps(a_max.x, b_min.x), _mm_cmpgt_ps(a_min.x, b_max.x));
+    separated = _mm_or_ps(separated, _mm_or_ps(_mm_cmplt_ps(a_max.y, b_min.y), _mm_cmpgt_ps(a_min.y, b_max.y)));
+    separated = _mm_or_ps(separated, _mm_or_ps(_mm_cmplt_ps(a_max.z, b_min.z), _mm_cmpgt_ps(a_min.z, b_max.z)));
+
+    total += batch::store_hits(~_mm_movemask_ps(separated) & 0xF, hits + i);
+  }
+#endif
+  // compare min and max directly, going through AABB::center and AABB::size would round differently
+  for (; i < count; i++) {
+    auto a_min = batch::load(a.min, i), a_max = batch::load(a.max, i);
+    auto b_min = batch::load(b.min, i), b_max = batch::load(b.max, i);
+    total += (hits[i] = !((a_max.x < b_min.x || a_min.x > b_max.x) || (a_max.y < b_min.y || a_min.y > b_max.y) ||
+                          (a_max.z < b_min.z || a_min.z > b_max.z)));
+  }
+  return total;
+}
+
+// test collisions between pairs of moving spheres, velocities are the displacement during the step
+int test_moving_collision(const SphereBatch& s0, const Vec3Batch& velocity0, const SphereBatch& s1,
+                          const Vec3Batch& velocity1, int count, float* t, uint8_t* hits) {
+  int i = 0, total = 0;
+#if SIMD_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 epsilon = _mm_set1_ps(EPSILON);
+  const __m128 miss = _mm_set1_ps(std::numeric_limits<float>::max());
+
+  for (; i + 4 <= count; i += 4) {
+    auto c0 = batch::load4(s0.center, i), c1 = batch::load4(s1.center, i);
+    auto radius = _mm_add_ps(_mm_loadu_ps(s0.radius + i), _mm_loadu_ps(s1.radius + i));
+
+    // page 226, ray from s0 along the relative velocity against s1 grown by the radius of s0
+    auto v = batch::sub4(batch::load4(velocity0, i), batch::load4(velocity1, i));
+    auto vlen = _mm_sqrt_ps(batch::dot4(v, v));
+
+    __m128 distance;
+    auto hit = batch::ray_sphere4(c0, batch::div4(v, vlen), c1, radius, &distance);
+    hit = _mm_and_ps(hit, _mm_cmple_ps(distance, vlen));
+
+    // spheres at rest relative to each other only collide if they already overlap
+    auto at_rest = _mm_cmplt_ps(vlen, epsilon);
+    auto delta = batch::sub4(c0, c1);
+    auto overlap = _mm_cmplt_ps(_mm_sqrt_ps(batch::dot4(delta, delta)), radius);
+
+    hit = simd::select(at_rest, overlap, hit);
+    distance = simd::select(at_rest, zero, distance);
+
+    _mm_storeu_ps(t + i, simd::select(hit, distance, miss));
+    total += batch::store_hits(_mm_movemask_ps(hit), hits + i);
+  }
+#endif
+  for (; i < count; i++) {
+    hits[i] = test_moving_collision(batch::load(s0, i), batch::load(velocity0, i), batch::load(s1, i),
+                                    batch::load(velocity1, i), &t[i]);
+    if (!hits[i]) t[i] = std::numeric_limits<float>::max();
+    total += hits[i];
+  }
+  return total;
+}
 };  // namespace collisions
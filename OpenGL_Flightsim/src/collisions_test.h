@@ -0,0 +1,285 @@
+/*
+    Unit tests and microbenchmarks for collisions.h, compare the batch tests against the scalar tests
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "broadphase.h"
+#include "collisions.h"
+#include "unittest.h"
+
+namespace collisions {
+
+// structure of arrays storage behind the batch views
+struct Vec3Array {
+  std::vector<float> x, y, z;
+
+  explicit Vec3Array(int count = 0) : x(count), y(count), z(count) {}
+
+  void set(int i, const glm::vec3& v) { x[i] = v.x, y[i] = v.y, z[i] = v.z; }
+
+  Vec3Batch view() const { return {x.data(), y.data(), z.data()}; }
+};
+
+struct Scenario {
+  int count;
+  Vec3Array center0, center1, velocity0, velocity1, direction, min0, max0, min1, max1;
+  std::vector<float> radius0, radius1;
+
+  // a mix of hits and misses, with some spheres at rest relative to each other
+  Scenario(int n, uint32_t seed)
+      : count(n),
+        center0(n),
+        center1(n),
+        velocity0(n),
+        velocity1(n),
+        direction(n),
+        min0(n),
+        max0(n),
+        min1(n),
+        max1(n),
+        radius0(n),
+        radius1(n) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f), radius(0.1f, 4.0f), unit(-1.0f, 1.0f);
+
+    for (int i = 0; i < n; i++) {
+      auto c0 = glm::vec3(position(rng), position(rng), position(rng));
+      auto c1 = glm::vec3(position(rng), position(rng), position(rng));
+      auto v0 = glm::vec3(position(rng), position(rng), position(rng));
+      auto v1 = (i % 7 == 0) ? v0 : glm::vec3(position(rng), position(rng), position(rng));
+      auto d = glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 0.01f);
+
+      center0.set(i, c0), center1.set(i, c1);
+      velocity0.set(i, v0), velocity1.set(i, v1);
+      direction.set(i, glm::normalize(d));
+      radius0[i] = radius(rng), radius1[i] = radius(rng);
+
+      auto e0 = glm::vec3(radius(rng), radius(rng), radius(rng));
+      auto e1 = glm::vec3(radius(rng), radius(rng), radius(rng));
+      min0.set(i, c0 - e0), max0.set(i, c0 + e0);
+      min1.set(i, c1 - e1), max1.set(i, c1 + e1);
+    }
+  }
+
+  SphereBatch spheres0() const { return {center0.view(), radius0.data()}; }
+  SphereBatch spheres1() const { return {center1.view(), radius1.data()}; }
+  RayBatch rays() const { return {center0.view(), direction.view()}; }
+  AABBBatch boxes0() const { return {min0.view(), max0.view()}; }
+  AABBBatch boxes1() const { return {min1.view(), max1.view()}; }
+};
+
+inline AABB make_aabb(const glm::vec3& min, const glm::vec3& max) {
+  AABB box;
+  box.center = (min + max) * 0.5f, box.size = max - min;
+  return box;
+}
+
+inline Sphere make_sphere(const glm::vec3& center, float radius) {
+  Sphere sphere;
+  sphere.center = center, sphere.radius = radius;
+  return sphere;
+}
+
+int run_unit_tests() {
+  const int failures = unittest::failures;
+  float t;
+
+  // spheres
+  CHECK(test_collision(make_sphere(glm::vec3(0.0f), 1.0f), make_sphere(glm::vec3(1.5f, 0.0f, 0.0f), 1.0f)));
+  CHECK(!test_collision(make_sphere(glm::vec3(0.0f), 1.0f), make_sphere(glm::vec3(2.5f, 0.0f, 0.0f), 1.0f)));
+
+  // boxes that overlap on only one or two axes are separated
+  auto box = make_aabb(glm::vec3(0.0f), glm::vec3(1.0f));
+  CHECK(test_collision(box, make_aabb(glm::vec3(0.5f), glm::vec3(2.0f))));
+  CHECK(test_collision(box, make_aabb(glm::vec3(0.25f), glm::vec3(0.75f))));
+  CHECK(!test_collision(box, make_aabb(glm::vec3(0.5f, 0.5f, 2.0f), glm::vec3(1.5f, 1.5f, 3.0f))));
+  CHECK(!test_collision(box, make_aabb(glm::vec3(2.0f, 0.5f, 0.5f), glm::vec3(3.0f, 1.5f, 1.5f))));
+  CHECK(!test_collision(box, make_aabb(glm::vec3(2.0f), glm::vec3(3.0f))));
+
+  // rays
+  Ray ray;
+  ray.origin = glm::vec3(-5.0f, 0.0f, 0.0f), ray.direction = glm::vec3(1.0f, 0.0f, 0.0f);
+  CHECK(test_collision(ray, make_sphere(glm::vec3(0.0f), 1.0f), &t) && std::abs(t - 4.0f) < 1e-5f);
+  CHECK(!test_collision(ray, make_sphere(glm::vec3(0.0f, 2.0f, 0.0f), 1.0f), &t));
+  CHECK(!test_collision(ray, make_sphere(glm::vec3(-10.0f, 0.0f, 0.0f), 1.0f), &t));
+
+  // moving spheres
+  auto s0 = make_sphere(glm::vec3(0.0f), 1.0f), s1 = make_sphere(glm::vec3(10.0f, 0.0f, 0.0f), 1.0f);
+  CHECK(test_moving_collision(s0, glm::vec3(10.0f, 0.0f, 0.0f), s1, glm::vec3(0.0f), &t) &&
+         std::abs(t - 8.0f) < 1e-5f);
+  CHECK(!test_moving_collision(s0, glm::vec3(5.0f, 0.0f, 0.0f), s1, glm::vec3(0.0f), &t));
+  CHECK(!test_moving_collision(s0, glm::vec3(1.0f), s1, glm::vec3(1.0f), &t));
+  CHECK(test_moving_collision(s0, glm::vec3(1.0f), make_sphere(glm::vec3(1.0f, 0.0f, 0.0f), 1.0f), glm::vec3(1.0f),
+                               &t) &&
+         t == 0.0f);
+
+  // batches have to agree with the scalar tests, odd sizes cover the scalar tail
+  for (int count : {0, 1, 3, 4, 5, 1023}) {
+    Scenario s(count, 42 + count);
+    std::vector<uint8_t> hits(count);
+    std::vector<float> times(count);
+    int total;
+
+    total = test_collision(s.spheres0(), s.spheres1(), count, hits.data());
+    for (int i = 0; i < count; i++) {
+      CHECK(hits[i] == test_collision(batch::load(s.spheres0(), i), batch::load(s.spheres1(), i)));
+      total -= hits[i];
+    }
+    CHECK(total == 0);
+
+    total = test_collision(s.rays(), s.spheres1(), count, times.data(), hits.data());
+    for (int i = 0; i < count; i++) {
+      bool hit = test_collision(batch::load(s.rays(), i), batch::load(s.spheres1(), i), &t);
+      CHECK(hits[i] == hit);
+      CHECK(hit ? std::abs(times[i] - t) <= 1e-4f * std::max(1.0f, t) : times[i] == std::numeric_limits<float>::max());
+      total -= hits[i];
+    }
+    CHECK(total == 0);
+
+    total = test_collision(s.boxes0(), s.boxes1(), count, hits.data());
+    for (int i = 0; i < count; i++) {
+      auto a_min = batch::load(s.boxes0().min, i), a_max = batch::load(s.boxes0().max, i);
+      auto b_min = batch::load(s.boxes1().min, i), b_max = batch::load(s.boxes1().max, i);
+      bool overlap = a_max.x >= b_min.x && a_min.x <= b_max.x && a_max.y >= b_min.y && a_min.y <= b_max.y &&
+                     a_max.z >= b_min.z && a_min.z <= b_max.z;
+      CHECK(hits[i] == overlap);
+      total -= hits[i];
+    }
+    CHECK(total == 0);
+
+    total = test_moving_collision(s.spheres0(), s.velocity0.view(), s.spheres1(), s.velocity1.view(), count,
+                                  times.data(), hits.data());
+    for (int i = 0; i < count; i++) {
+      bool hit = test_moving_collision(batch::load(s.spheres0(), i), batch::load(s.velocity0.view(), i),
+                                       batch::load(s.spheres1(), i), batch::load(s.velocity1.view(), i), &t);
+      CHECK(hits[i] == hit);
+      CHECK(hit ? std::abs(times[i] - t) <= 1e-4f * std::max(1.0f, t) : times[i] == std::numeric_limits<float>::max());
+      total -= hits[i];
+    }
+    CHECK(total == 0);
+  }
+
+  // sweep and prune has to find the same pairs as testing all of them, while boxes move, leave and come back
+  {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f), size(0.5f, 8.0f), step(-2.0f, 2.0f);
+
+    const int count = 200;
+    std::vector<AABB> boxes(count);
+    std::vector<uint32_t> layers(count), masks(count);
+    std::vector<int> ids(count);
+    SweepAndPrune broadphase(1);
+
+    for (int i = 0; i < count; i++) {
+      boxes[i].center = glm::vec3(position(rng), position(rng), position(rng));
+      boxes[i].size = glm::vec3(size(rng), size(rng), size(rng));
+      layers[i] = 1U << (i % 3), masks[i] = (i % 5 == 0) ? 1U : ~0U;
+      ids[i] = broadphase.add(boxes[i], layers[i], masks[i]);
+    }
+
+    for (int frame = 0; frame < 20; frame++) {
+      for (int i = 0; i < count; i++) {
+        boxes[i].center += glm::vec3(step(rng), step(rng), step(rng));
+        broadphase.update(ids[i], boxes[i]);
+      }
+
+      // some proxies are replaced, their ids get reused
+      for (int i = frame; i < count; i += 37) {
+        broadphase.remove(ids[i]);
+        if (frame % 2 == 0) broadphase.find_pairs();
+        ids[i] = broadphase.add(boxes[i], layers[i], masks[i]);
+      }
+
+      std::vector<std::pair<int, int>> found, expected;
+      for (const auto& pair : broadphase.find_pairs()) found.push_back({pair.a, pair.b});
+
+      for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+          if (!(layers[i] & masks[j]) && !(layers[j] & masks[i])) continue;
+          if (!test_collision(boxes[i], boxes[j])) continue;
+          expected.push_back({std::min(ids[i], ids[j]), std::max(ids[i], ids[j])});
+        }
+      }
+
+      std::sort(found.begin(), found.end()), std::sort(expected.begin(), expected.end());
+      CHECK(found == expected);
+    }
+  }
+
+  return unittest::report("collisions", failures);
+}
+
+// time `func` over many repetitions and print the cost per test
+template <typename Func>
+void benchmark(const char* name, int count, Func&& func) {
+  const int repetitions = 200;
+  volatile int sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < repetitions; r++) sink = sink + func();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%-24s %8.2f ns/test\n", name, elapsed * 1e9 / (static_cast<double>(repetitions) * count));
+}
+
+void run_benchmarks() {
+  const int count = 1 << 16;
+  Scenario s(count, 1);
+  std::vector<uint8_t> hits(count);
+  std::vector<float> times(count);
+
+  benchmark("sphere/sphere scalar", count, [&]() {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+      total += (hits[i] = test_collision(batch::load(s.spheres0(), i), batch::load(s.spheres1(), i)));
+    }
+    return total;
+  });
+  benchmark("sphere/sphere batch", count,
+            [&]() { return test_collision(s.spheres0(), s.spheres1(), count, hits.data()); });
+
+  benchmark("ray/sphere scalar", count, [&]() {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+      total += (hits[i] = test_collision(batch::load(s.rays(), i), batch::load(s.spheres1(), i), &times[i]));
+    }
+    return total;
+  });
+  benchmark("ray/sphere batch", count,
+            [&]() { return test_collision(s.rays(), s.spheres1(), count, times.data(), hits.data()); });
+
+  benchmark("aabb/aabb scalar", count, [&]() {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+      total += (hits[i] = test_collision(batch::load(s.boxes0(), i), batch::load(s.boxes1(), i)));
+    }
+    return total;
+  });
+  benchmark("aabb/aabb batch", count, [&]() { return test_collision(s.boxes0(), s.boxes1(), count, hits.data()); });
+
+  benchmark("moving spheres scalar", count, [&]() {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+      total += (hits[i] = test_moving_collision(batch::load(s.spheres0(), i), batch::load(s.velocity0.view(), i),
+                                                batch::load(s.spheres1(), i), batch::load(s.velocity1.view(), i),
+                                                &times[i]));
+    }
+    return total;
+  });
+  benchmark("moving spheres batch", count, [&]() {
+    return test_moving_collision(s.spheres0(), s.velocity0.view(), s.spheres1(), s.velocity1.view(), count,
+                                 times.data(), hits.data());
+  });
+}
+};  // namespace collisions
@@ -0,0 +1,253 @@
+/*
+    Convex collision hulls built from obj models, a few hulls per model approximate the non convex airframe
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace collisions {
+
+struct HullParams {
+  int max_depth = 2;      // every object in the obj file is split in half up to this many times
+  int directions = 1024;  // sample directions for the hull vertices, more directions catch more vertices
+  float min_size = 2.0f;  // objects smaller than this are never split, m
+};
+
+// convex hull given by its vertices, which is all that the support mapping of gjk needs
+struct ConvexHull {
+  std::vector<glm::vec3> vertices;
+  glm::vec3 center{};   // of the bounding sphere
+  float radius = 0.0f;  // of the bounding sphere
+
+  // vertex furthest along direction
+  glm::vec3 support(const glm::vec3& direction) const {
+    int best = 0;
+    float max = glm::dot(vertices[0], direction);
+    for (int i = 1; i < static_cast<int>(vertices.size()); i++) {
+      float d = glm::dot(vertices[i], direction);
+      if (d > max) max = d, best = i;
+    }
+    return vertices[best];
+  }
+};
+
+// radius of a sphere around the model space origin that contains all hulls
+inline float get_bounding_radius(const std::vector<ConvexHull>& hulls) {
+  float radius = 0.0f;
+  for (const auto& hull : hulls) radius = std::max(radius, glm::length(hull.center) + hull.radius);
+  return radius;
+}
+
+namespace hull {
+
+struct Triangle {
+  int v[3];
+};
+
+struct Part {
+  std::vector<glm::vec3> positions;
+  std::vector<Triangle> triangles;
+};
+
+// every "o" or "g" block of an obj file as a separate part, only positions and faces are read
+std::vector<Part> load_obj_parts(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    printf("hull: could not open %s\n", path.c_str());
+    return {};
+  }
+
+  std::vector<glm::vec3> positions;
+  std::vector<Part> parts(1);
+  std::string line, token;
+
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    if (!(stream >> token)) continue;
+
+    if (token == "v") {
+      glm::vec3 p;
+      stream >> p.x >> p.y >> p.z;
+      positions.push_back(p);
+    } else if ((token == "o" || token == "g") && !parts.back().triangles.empty()) {
+      parts.emplace_back();
+    } else if (token == "f") {
+      // faces are fans, indices are 1 based or relative to the end when negative
+      std::vector<int> face;
+      while (stream >> token) {
+        int index = std::stoi(token.substr(0, token.find('/')));
+        face.push_back(index > 0 ? index - 1 : static_cast<int>(positions.size()) + index);
+      }
+      for (size_t i = 2; i < face.size(); i++) parts.back().triangles.push_back({face[0], face[i - 1], face[i]});
+    }
+  }
+
+  // positions are shared by the whole file, give every part only the ones it uses
+  for (auto& part : parts) {
+    std::vector<int> remap(positions.size(), -1);
+    for (auto& triangle : part.triangles) {
+      for (int& v : triangle.v) {
+        if (remap[v] < 0) remap[v] = static_cast<int>(part.positions.size()), part.positions.push_back(positions[v]);
+        v = remap[v];
+      }
+    }
+  }
+
+  parts.erase(std::remove_if(parts.begin(), parts.end(), [](const Part& part) { return part.triangles.empty(); }),
+              parts.end());
+  return parts;
+}
+
+// vertices that are extreme along evenly spread directions. the hull of these is the hull of the points, apart
+// from vertices that are never extreme along a sampled direction, which are within a few cm of it for aircraft
+ConvexHull build(const std::vector<glm::vec3>& points, int directions) {
+  ConvexHull result;
+  if (points.empty()) return result;
+
+  std::vector<uint8_t> extreme(points.size(), 0);
+
+  // fibonacci sphere
+  const float golden_angle = 2.39996323f;
+  for (int i = 0; i < directions; i++) {
+    const float y = 1.0f - 2.0f * (static_cast<float>(i) + 0.5f) / static_cast<float>(directions);
+    const float r = std::sqrt(std::max(0.0f, 1.0f - y * y));
+    const float phi = golden_angle * static_cast<float>(i);
+    const glm::vec3 direction(r * std::cos(phi), y, r * std::sin(phi));
+
+    size_t best = 0;
+    for (size_t j = 1; j < points.size(); j++) {
+      if (glm::dot(points[j], direction) > glm::dot(points[best], direction)) best = j;
+    }
+    extreme[best] = 1;
+  }
+
+  for (size_t i = 0; i < points.size(); i++) {
+    if (extreme[i]) result.vertices.push_back(points[i]);
+  }
+
+  glm::vec3 min = result.vertices[0], max = result.vertices[0];
+  for (const auto& v : result.vertices) min = glm::min(min, v), max = glm::max(max, v);
+
+  result.center = (min + max) * 0.5f;
+  for (const auto& v : result.vertices) result.radius = std::max(result.radius, glm::length(v - result.center));
+  return result;
+}
+
+// split the triangles of a part at the middle of its longest axis, triangles go to the side of their centroid and
+// keep all of their vertices so the hulls of both halves still cover the surface
+void decompose(const std::vector<glm::vec3>& positions, const std::vector<Triangle>& triangles, int depth,
+               const HullParams& params, std::vector<ConvexHull>& hulls) {
+  glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+  for (const auto& triangle : triangles) {
+    for (int v : triangle.v) min = glm::min(min, positions[v]), max = glm::max(max, positions[v]);
+  }
+
+  const auto size = max - min;
+  const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+  if (depth >= params.max_depth || size[axis] < params.min_size || triangles.size() < 2) {
+    std::vector<glm::vec3> points;
+    for (const auto& triangle : triangles) {
+      for (int v : triangle.v) points.push_back(positions[v]);
+    }
+    hulls.push_back(build(points, params.directions));
+    return;
+  }
+
+  const float middle = (min[axis] + max[axis]) * 0.5f;
+  std::vector<Triangle> lower, upper;
+  for (const auto& triangle : triangles) {
+    const float centroid = (positions[triangle.v[0]][axis] + positions[triangle.v[1]][axis] +
+                            positions[triangle.v[2]][axis]) / 3.0f;
+    (centroid < middle ? lower : upper).push_back(triangle);
+  }
+
+  for (const auto* half : {&lower, &upper}) {
+    if (!half->empty()) decompose(positions, *half, depth + 1, params, hulls);
+  }
+}
+
+constexpr uint32_t CACHE_MAGIC = 0x4c4c5548;  // "HULL"
+constexpr uint32_t CACHE_VERSION = 1;
+
+bool read_cache(const std::string& path, const HullParams& params, std::vector<ConvexHull>& hulls) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  uint32_t magic, version, count;
+  HullParams cached;
+  file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&cached), sizeof(cached));
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+  if (!file || magic != CACHE_MAGIC || version != CACHE_VERSION) return false;
+  if (cached.max_depth != params.max_depth || cached.directions != params.directions ||
+      cached.min_size != params.min_size) {
+    return false;
+  }
+
+  hulls.resize(count);
+  for (auto& hull : hulls) {
+    uint32_t size;
+    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!file) return false;
+
+    hull.vertices.resize(size);
+    file.read(reinterpret_cast<char*>(hull.vertices.data()), size * sizeof(glm::vec3));
+    file.read(reinterpret_cast<char*>(&hull.center), sizeof(hull.center));
+    file.read(reinterpret_cast<char*>(&hull.radius), sizeof(hull.radius));
+  }
+  return static_cast<bool>(file);
+}
+
+void write_cache(const std::string& path, const HullParams& params, const std::vector<ConvexHull>& hulls) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) return;
+
+  const uint32_t magic = CACHE_MAGIC, version = CACHE_VERSION, count = static_cast<uint32_t>(hulls.size());
+  file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  file.write(reinterpret_cast<const char*>(&params), sizeof(params));
+  file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+  for (const auto& hull : hulls) {
+    const uint32_t size = static_cast<uint32_t>(hull.vertices.size());
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(reinterpret_cast<const char*>(hull.vertices.data()), size * sizeof(glm::vec3));
+    file.write(reinterpret_cast<const char*>(&hull.center), sizeof(hull.center));
+    file.write(reinterpret_cast<const char*>(&hull.radius), sizeof(hull.radius));
+  }
+}
+};  // namespace hull
+
+// convex hulls of an obj model in model space. they are cached next to the model in <path>.hulls and only rebuilt
+// when the model is newer than the cache or the params changed
+std::vector<ConvexHull> load_convex_hulls(const std::string& path, const HullParams& params = {}) {
+  namespace fs = std::filesystem;
+  const std::string cache_path = path + ".hulls";
+  std::vector<ConvexHull> hulls;
+
+  std::error_code error;
+  const bool fresh = fs::exists(cache_path, error) &&
+                     fs::last_write_time(cache_path, error) >= fs::last_write_time(path, error) && !error;
+
+  if (fresh && hull::read_cache(cache_path, params, hulls)) return hulls;
+
+  hulls.clear();
+  for (const auto& part : hull::load_obj_parts(path)) hull::decompose(part.positions, part.triangles, 0, params, hulls);
+
+  if (!hulls.empty()) hull::write_cache(cache_path, params, hulls);
+  return hulls;
+}
+};  // namespace collisions
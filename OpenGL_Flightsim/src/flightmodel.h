@@ -8,6 +8,8 @@
 
 #include "data.h"
 #include "gfx.h"
+#include "landinggear.h"
+#include "loadout.h"
 #include "phi.h"
 
 #define DEBUG_FLIGHTMODEL 0
@@ -88,7 +90,8 @@ struct Airfoil {
   // get lift coefficent and drag coefficient
   std::tuple<float, float> sample(float alpha) const {
     int max_index = data.size() - 1;
-    float t = phi::inverse_lerp(min_alpha, max_alpha, alpha) * max_index;
+    // angles outside of the data, e.g. while rolling on the ground, use the closest sample
+    float t = std::clamp(phi::inverse_lerp(min_alpha, max_alpha, alpha), 0.0f, 1.0f) * max_index;
     float integer = std::floor(t);
     float fractional = t - integer;
     int index = static_cast<int>(integer);
@@ -100,9 +103,13 @@ struct Airfoil {
 struct Engine : public phi::ForceEffector {
   float throttle = 0.25f;
   float thrust = 10000.0f;
+  float fuel_consumption = 2.3e-5f;  // kg/s per N of thrust, a turbofan at military power
 
   Engine(float thrust) : thrust(thrust) {}
 
+  // kg/s
+  inline float get_fuel_flow() const { return fuel_consumption * thrust * throttle; }
+
   void apply_forces(phi::RigidBody& rigid_body, phi::Seconds dt) override {
     rigid_body.add_relative_force({thrust * throttle, 0.0f, 0.0f});
   }
@@ -167,11 +174,12 @@ struct Wing : public phi::ForceEffector {
     // drag acts in the opposite direction of velocity
     glm::vec3 drag_direction = glm::normalize(-local_velocity);
 
-    // lift is always perpendicular to drag
-    glm::vec3 lift_direction = glm::normalize(glm::cross(glm::cross(drag_direction, wing_normal), drag_direction));
+    // lift is always perpendicular to drag, there is none if the air flows straight into the wing
+    glm::vec3 lift_direction = glm::cross(glm::cross(drag_direction, wing_normal), drag_direction);
+    lift_direction = glm::length(lift_direction) > phi::EPSILON ? glm::normalize(lift_direction) : glm::vec3(0.0f);
 
-    // angle between chord line and air flow
-    float angle_of_attack = glm::degrees(std::asin(glm::dot(drag_direction, wing_normal)));
+    // angle between chord line and air flow, rounding can push the dot product of unit vectors past 1
+    float angle_of_attack = glm::degrees(std::asin(glm::clamp(glm::dot(drag_direction, wing_normal), -1.0f, 1.0f)));
 
     // sample our aerodynamic data
     auto [lift_coefficient, drag_coefficient] = airfoil->sample(angle_of_attack);
@@ -223,10 +231,17 @@ struct Airplane {
   Engine engine;
   std::vector<Wing> wings;
   phi::RigidBody rigid_body;
+  LandingGear gear;
+  Loadout loadout;
   glm::vec3 joystick{};  // roll, yaw, pitch
 
-  Airplane(float mass, float thrust, glm::mat3 inertia, std::vector<Wing> elements)
-      : wings(elements), rigid_body({.mass = mass, .inertia = inertia}), engine(thrust) {
+  // inertia about the center of gravity of the empty airframe, which is relative to the body origin
+  Airplane(float mass, float thrust, glm::mat3 inertia, std::vector<Wing> elements,
+           const glm::vec3& center_of_gravity = glm::vec3(0.0f))
+      : wings(elements),
+        rigid_body({.mass = mass, .inertia = inertia}),
+        engine(thrust),
+        loadout(mass, inertia, center_of_gravity) {
 #if DEBUG_FLIGHTMODEL
     wings[0].log = false;
     wings[0].name = "lw";
@@ -273,8 +288,16 @@ struct Airplane {
       wing.apply_forces(rigid_body, dt);
     }
 
-    engine.apply_forces(rigid_body, dt);
+    if (loadout.has_fuel()) {
+      engine.apply_forces(rigid_body, dt);
+      loadout.burn(engine.get_fuel_flow() * dt);
+    }
+
+    // weight acts at the center of gravity, which moves away from the body origin as fuel burns and stores drop
+    const auto weight = rigid_body.inverse_transform_direction(phi::DOWN * (rigid_body.mass * phi::EARTH_GRAVITY));
+    rigid_body.add_relative_torque(glm::cross(loadout.get_center_of_gravity(), weight));
+    loadout.update(rigid_body, dt);
 
-    rigid_body.update(dt);
+    gear.update(rigid_body, dt);
   }
 };
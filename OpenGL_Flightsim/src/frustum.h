@@ -0,0 +1,104 @@
+/*
+    View frustum culling of bounding spheres, the planes are extracted from the view projection matrix
+    https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+*/
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+#include "simd.h"
+
+#define RUN_FRUSTUM_UNITTESTS 0
+
+namespace gfx {
+
+struct BoundingSphere {
+  glm::vec3 center{0.0f};
+  float radius = std::numeric_limits<float>::infinity();  // infinite spheres are never culled
+};
+
+// bounding spheres as structure of arrays for the batch test
+struct BoundsBatch {
+  std::vector<float> x, y, z, radius;
+
+  inline void clear() { x.clear(), y.clear(), z.clear(), radius.clear(); }
+
+  inline void push_back(const BoundingSphere& sphere) {
+    x.push_back(sphere.center.x), y.push_back(sphere.center.y), z.push_back(sphere.center.z);
+    radius.push_back(sphere.radius);
+  }
+
+  inline int size() const { return static_cast<int>(x.size()); }
+};
+
+class Frustum {
+ public:
+  // planes of everything view_projection maps into clip space, e.g. projection * view or a light space matrix
+  explicit Frustum(const glm::mat4& view_projection) {
+    const glm::mat4 m = glm::transpose(view_projection);  // rows of the matrix as columns
+
+    planes[0] = m[3] + m[0];  // left
+    planes[1] = m[3] - m[0];  // right
+    planes[2] = m[3] + m[1];  // bottom
+    planes[3] = m[3] - m[1];  // top
+    planes[4] = m[3] + m[2];  // near
+    planes[5] = m[3] - m[2];  // far
+
+    // normalized so distances to the planes can be compared with radii
+    for (auto& plane : planes) plane /= glm::length(glm::vec3(plane));
+  }
+
+  // normals point inside, dot(normal, p) + w is the distance of p to the plane
+  glm::vec4 planes[6];
+
+  // true unless the sphere is completely outside of a plane
+  inline bool test(const BoundingSphere& sphere) const {
+    for (const auto& plane : planes) {
+      if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) return false;
+    }
+    return true;
+  }
+
+  // true unless the box is completely outside of a plane, only the corner furthest along the normal is tested
+  inline bool test(const glm::vec3& min, const glm::vec3& max) const {
+    for (const auto& plane : planes) {
+      const glm::vec3 corner(plane.x > 0.0f ? max.x : min.x, plane.y > 0.0f ? max.y : min.y,
+                             plane.z > 0.0f ? max.z : min.z);
+      if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+    }
+    return true;
+  }
+
+  // writes 1 to visible[i] for every sphere that passes test() and 0 otherwise, returns the number of visible spheres
+  int test(const BoundsBatch& spheres, uint8_t* visible) const {
+    const int count = spheres.size();
+    int i = 0, total = 0;
+#if SIMD_SSE2
+    for (; i + 4 <= count; i += 4) {
+      const auto x = _mm_loadu_ps(spheres.x.data() + i), y = _mm_loadu_ps(spheres.y.data() + i);
+      const auto z = _mm_loadu_ps(spheres.z.data() + i);
+      const auto limit = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius.data() + i));
+
+      auto inside = _mm_cmpeq_ps(x, x);
+      for (const auto& plane : planes) {
+        auto distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y));
+        distance = _mm_add_ps(_mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), z)), _mm_set1_ps(plane.w));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, limit));
+      }
+
+      const int bits = _mm_movemask_ps(inside);
+      for (int k = 0; k < 4; k++) total += (visible[i + k] = static_cast<uint8_t>((bits >> k) & 1));
+    }
+#endif
+    for (; i < count; i++) {
+      const BoundingSphere sphere{{spheres.x[i], spheres.y[i], spheres.z[i]}, spheres.radius[i]};
+      total += (visible[i] = test(sphere));
+    }
+    return total;
+  }
+};
+};  // namespace gfx
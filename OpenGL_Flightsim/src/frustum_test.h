@@ -0,0 +1,48 @@
+/*
+    Unit tests for frustum.h, the simd path has to agree with the scalar test
+*/
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "frustum.h"
+#include "unittest.h"
+
+namespace gfx {
+
+inline int run_frustum_tests() {
+  const int failures = unittest::failures;
+
+  // infinite spheres are never culled, odd counts cover the scalar tail
+  const auto view = glm::lookAt(glm::vec3(10.0f, 20.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  const Frustum frustum(glm::perspective(glm::radians(45.0f), 1.5f, 1.0f, 1000.0f) * view);
+
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> position(-600.0f, 600.0f), radius(0.0f, 50.0f);
+
+  for (int count : {0, 1, 3, 4, 5, 1023}) {
+    BoundsBatch spheres;
+    for (int i = 0; i < count; i++) {
+      const float r = i % 5 == 0 ? std::numeric_limits<float>::infinity() : radius(rng);
+      spheres.push_back({glm::vec3(position(rng), position(rng), position(rng)), r});
+    }
+
+    std::vector<uint8_t> visible(count);
+    int total = frustum.test(spheres, visible.data());
+    for (int i = 0; i < count; i++) {
+      const BoundingSphere sphere{{spheres.x[i], spheres.y[i], spheres.z[i]}, spheres.radius[i]};
+      CHECK(visible[i] == frustum.test(sphere));
+      if (std::isinf(sphere.radius)) CHECK(visible[i] == 1);
+      total -= visible[i];
+    }
+    CHECK(total == 0);
+  }
+
+  return unittest::report("frustum", failures);
+}
+};  // namespace gfx
@@ -62,6 +62,10 @@ Shader::Shader(const std::string& vertShader, const std::string& fragShader) {
   }
   glDeleteShader(vertexShader);
   glDeleteShader(fragmentShader);
+
+  cache_uniforms();
+  uniform_block("FrameData", FRAME_DATA_BINDING);
+  uniform_block("LightData", LIGHT_DATA_BINDING);
 }
 
 Shader::~Shader() { glDeleteProgram(id); }
@@ -70,26 +74,76 @@ void Shader::bind() const { glUseProgram(id); }
 
 void Shader::unbind() const { glUseProgram(0); }
 
-void Shader::uniform(const std::string& name, int value) { glUniform1i(glGetUniformLocation(id, name.c_str()), value); }
+void Shader::cache_uniforms() {
+  GLint count = 0, max_length = 0;
+  glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+  glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+  std::vector<char> name(std::max(max_length, 1));
+  for (GLint i = 0; i < count; i++) {
+    GLsizei length;
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(id, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+
+    std::string key(name.data(), length);
+    GLint location = glGetUniformLocation(id, key.c_str());
+    if (location < 0) continue;  // uniform blocks
+
+    // arrays are listed as "name[0]", they can be set by "name" as well
+    if (key.ends_with("[0]")) m_uniforms.emplace(key.substr(0, key.size() - 3), location);
+    m_uniforms.emplace(std::move(key), location);
+  }
+}
+
+UniformHandle Shader::get_uniform(std::string_view name) {
+  auto it = m_uniforms.find(name);
+  if (it != m_uniforms.end()) return {it->second};
 
-void Shader::uniform(const std::string& name, unsigned int value) {
-  glUniform1ui(glGetUniformLocation(id, name.c_str()), value);
+  // elements of arrays other than the first, misspelled names are cached as -1 too
+  std::string key(name);
+  GLint location = glGetUniformLocation(id, key.c_str());
+  m_uniforms.emplace(std::move(key), location);
+  return {location};
 }
 
-void Shader::uniform(const std::string& name, float value) {
-  glUniform1f(glGetUniformLocation(id, name.c_str()), value);
+void Shader::uniform_block(const std::string& name, GLuint binding) {
+  GLuint index = glGetUniformBlockIndex(id, name.c_str());
+  if (index != GL_INVALID_INDEX) glUniformBlockBinding(id, index, binding);
 }
 
-void Shader::uniform(const std::string& name, const glm::vec3& value) {
-  glUniform3fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]);
+void Shader::uniform(UniformHandle handle, int value) { glUniform1i(handle.location, value); }
+
+void Shader::uniform(UniformHandle handle, unsigned int value) { glUniform1ui(handle.location, value); }
+
+void Shader::uniform(UniformHandle handle, float value) { glUniform1f(handle.location, value); }
+
+void Shader::uniform(UniformHandle handle, const glm::vec3& value) { glUniform3fv(handle.location, 1, &value[0]); }
+
+void Shader::uniform(UniformHandle handle, const glm::vec4& value) { glUniform4fv(handle.location, 1, &value[0]); }
+
+void Shader::uniform(UniformHandle handle, const glm::mat4& value) {
+  glUniformMatrix4fv(handle.location, 1, GL_FALSE, &value[0][0]);
 }
 
-void Shader::uniform(const std::string& name, const glm::vec4& value) {
-  glUniform4fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]);
+void Shader::uniform(UniformHandle handle, const glm::vec4* values, int count) {
+  glUniform4fv(handle.location, count, &values[0][0]);
 }
 
-void Shader::uniform(const std::string& name, const glm::mat4& value) {
-  glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &value[0][0]);
+void Shader::uniform(std::string_view name, int value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, unsigned int value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, float value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, const glm::vec3& value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, const glm::vec4& value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, const glm::mat4& value) { uniform(get_uniform(name), value); }
+
+void Shader::uniform(std::string_view name, const glm::vec4* values, int count) {
+  uniform(get_uniform(name), values, count);
 }
 
 Texture::Texture(const std::string& path) : Texture(path, {}) {}
@@ -189,6 +243,34 @@ void CubemapTexture::bind(GLuint texture) const {
 
 void CubemapTexture::unbind() const { glBindTexture(GL_TEXTURE_CUBE_MAP, 0); }
 
+TextureArray::TextureArray(int width, int height, int layers, GLint internal_format, const TextureParams& params) {
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, params.texture_wrap_s);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, params.texture_wrap_t);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, params.texture_min_filter);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, params.texture_mag_filter);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internal_format, width, height, layers);
+}
+
+void TextureArray::bind(GLuint texture) const {
+  glActiveTexture(GL_TEXTURE0 + texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+}
+
+void TextureArray::unbind() const { glBindTexture(GL_TEXTURE_2D_ARRAY, 0); }
+
+void TextureArray::update(int layer, int x, int y, int width, int height, GLenum format, GLenum type,
+                          const void* data) {
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, height, 1, format, type, data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
 VertexBuffer::VertexBuffer() { glGenBuffers(1, &id); }
 
 VertexBuffer::~VertexBuffer() { glDeleteBuffers(1, &id); }
@@ -197,9 +279,9 @@ void VertexBuffer::bind() const { glBindBuffer(GL_ARRAY_BUFFER, id); }
 
 void VertexBuffer::unbind() const { glBindBuffer(GL_ARRAY_BUFFER, 0); }
 
-void VertexBuffer::buffer(const void* data, size_t size) {
+void VertexBuffer::buffer(const void* data, size_t size, GLenum usage) {
   bind();
-  glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, size, data, usage);
 }
 
 VertexArrayObject::VertexArrayObject() { glGenVertexArrays(1, &id); }
@@ -210,6 +292,22 @@ void VertexArrayObject::bind() const { glBindVertexArray(id); }
 
 void VertexArrayObject::unbind() const { glBindVertexArray(0); }
 
+UniformBuffer::UniformBuffer() { glGenBuffers(1, &id); }
+
+UniformBuffer::~UniformBuffer() { glDeleteBuffers(1, &id); }
+
+void UniformBuffer::bind() const { glBindBuffer(GL_UNIFORM_BUFFER, id); }
+
+void UniformBuffer::unbind() const { glBindBuffer(GL_UNIFORM_BUFFER, 0); }
+
+void UniformBuffer::bind_base(GLuint binding) const { glBindBufferBase(GL_UNIFORM_BUFFER, binding, id); }
+
+void UniformBuffer::buffer(const void* data, size_t size) {
+  bind();
+  // a new store every frame, so the driver doesn't wait for draws that still read the old one
+  glBufferData(GL_UNIFORM_BUFFER, size, data, GL_STREAM_DRAW);
+}
+
 ElementBufferObject::ElementBufferObject() { glGenBuffers(1, &id); }
 
 ElementBufferObject::~ElementBufferObject() { glDeleteBuffers(1, &id); }
@@ -252,9 +350,24 @@ Geometry::Geometry(const std::vector<float>& vertices, const VertexLayout& layou
 
   vbo.unbind();
   vao.bind();
+
+  if (triangle_count > 0) {
+    min = max = glm::vec3(vertices[0], vertices[1], vertices[2]);
+    for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+      const glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+      min = glm::min(min, position), max = glm::max(max, position);
+    }
+
+    bounds.center = (min + max) * 0.5f, bounds.radius = 0.0f;
+    for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+      const glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+      bounds.radius = std::max(bounds.radius, glm::length(position - bounds.center));
+    }
+  }
 }
 
-Geometry::Geometry(const Geometry& geometry) { triangle_count = geometry.triangle_count; }
+Geometry::Geometry(const Geometry& geometry)
+    : triangle_count(geometry.triangle_count), min(geometry.min), max(geometry.max), bounds(geometry.bounds) {}
 
 Geometry::~Geometry() {}
 
@@ -262,6 +375,30 @@ void Geometry::bind() { vao.bind(); }
 
 void Geometry::unbind() { vao.unbind(); }
 
+void Geometry::set_instance_buffer(const gl::VertexBuffer& buffer) {
+  // the vertex array remembers the buffer, which keeps its id when its data is replaced
+  if (m_instance_buffer == buffer.id) return;
+  m_instance_buffer = buffer.id;
+
+  buffer.bind();
+  const GLsizei stride = sizeof(InstanceData);
+
+  // a mat4 takes up four vec4 attributes
+  for (GLuint i = 0; i < 4; i++) {
+    glVertexAttribPointer(INSTANCE_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, stride,
+                          (void*)(offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+    glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + i);
+    glVertexAttribDivisor(INSTANCE_ATTRIBUTE + i, 1);
+  }
+
+  glVertexAttribPointer(INSTANCE_ATTRIBUTE + 4, 1, GL_FLOAT, GL_FALSE, stride,
+                        (void*)offsetof(InstanceData, receive_shadow));
+  glEnableVertexAttribArray(INSTANCE_ATTRIBUTE + 4);
+  glVertexAttribDivisor(INSTANCE_ATTRIBUTE + 4, 1);
+
+  buffer.unbind();
+}
+
 int Geometry::get_stride(const VertexLayout& layout) {
   switch (layout) {
     case POS:
@@ -289,8 +426,15 @@ void Camera::look_at(const glm::vec3& target) {
 template <class Derived>
 std::shared_ptr<gl::Shader> MaterialX<Derived>::shader = nullptr;
 
+template <class Derived>
+std::shared_ptr<MeshUniforms> MaterialX<Derived>::uniforms = nullptr;
+
+MeshUniforms::MeshUniforms(gl::Shader& shader) : shadow_map(shader.get_uniform("u_ShadowMap")) {}
+
 int Object3D::counter = 0;
 
+int Material::counter = 0;
+
 void Object3D::draw(RenderContext& context) {
   if (visible) {
     draw_self(context);
@@ -357,6 +501,21 @@ void Object3D::traverse(const std::function<bool(Object3D*)>& func) {
   }
 }
 
+void Object3D::update_world_bounds() {
+  const auto local = get_local_bounds();
+  if (std::isinf(local.radius)) {
+    world_bounds = {glm::vec3(transform[3]), local.radius};
+    return;
+  }
+
+  // the longest axis of the transform scales the radius
+  const float scale = std::sqrt(std::max({glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                          glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                          glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))}));
+
+  world_bounds = {glm::vec3(transform * glm::vec4(local.center, 1.0f)), local.radius * scale};
+}
+
 void Object3D::override_transform(const glm::mat4& matrix) {
   m_dirty_transform = true;
   m_dirty_dof = true;
@@ -378,7 +537,9 @@ void Object3D::update_world_matrix(bool dirtyParent) {
     child->update_world_matrix(dirty || m_dirty_transform);
   }
 
-  m_dirty_dof = m_dirty_transform = false;
+  if (dirty || m_dirty_transform || m_dirty_bounds) update_world_bounds();
+
+  m_dirty_dof = m_dirty_transform = m_dirty_bounds = false;
 }
 
 Object3D& Object3D::add(Object3D* child) {
@@ -416,6 +577,7 @@ void Renderer::render(Camera& camera, Object3D& scene) {
   context.shadow_map = shadow_map;
   context.shadow_caster = nullptr;
   context.background_color = background;
+  context.instance_buffer = &instance_buffer;
 
   scene.traverse([&context](Object3D* obj) {
     if (obj->get_type() == Object3D::Type::LIGHT) {
@@ -430,12 +592,32 @@ void Renderer::render(Camera& camera, Object3D& scene) {
     return true;
   });
 
+  FrameData frame{};
+  frame.view = camera.get_view_matrix();
+  frame.projection = camera.get_projection_matrix();
+  frame.light_space_matrix = context.shadow_caster ? context.shadow_caster->light_space_matrix() : glm::mat4(1.0f);
+  frame.camera_position = camera.get_world_position();
+  frame.background_color = background;
+
+  LightData lights{};
+  lights.count = std::min(static_cast<int>(context.lights.size()), MAX_LIGHTS);
+  for (int i = 0; i < lights.count; i++) {
+    lights.lights[i].type = context.lights[i]->type;
+    lights.lights[i].color = context.lights[i]->rgb;
+    lights.lights[i].position = context.lights[i]->get_world_position();
+  }
+
+  frame_data.buffer(frame);
+  frame_data.bind_base(FRAME_DATA_BINDING);
+  light_data.buffer(lights);
+  light_data.bind_base(LIGHT_DATA_BINDING);
+
   if (shadow_map && context.shadow_caster) {
     context.is_shadow_pass = true;
     glViewport(0, 0, shadow_map->width, shadow_map->height);
     glBindFramebuffer(GL_FRAMEBUFFER, shadow_map->fbo);
     glClear(GL_DEPTH_BUFFER_BIT);
-    scene.draw(context);
+    draw_queue(scene, context);
   }
 
   context.is_shadow_pass = false;
@@ -446,61 +628,99 @@ void Renderer::render(Camera& camera, Object3D& scene) {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 #if 1
-  scene.draw(context);
+  draw_queue(scene, context);
 #else
   screen_quad->draw(context);
 #endif
 }
 
-void Mesh::draw_self(RenderContext& context) {
-  glm::mat4 lightSpaceMatrix(1.0f);
+void Renderer::draw_queue(Object3D& scene, RenderContext& context) {
+  candidates.clear();
+  candidate_bounds.clear();
+  scene.traverse([this](Object3D* obj) {
+    if (obj->visible) {
+      candidates.push_back(obj);
+      candidate_bounds.push_back(obj->world_bounds);
+    }
+    return true;
+  });
 
-  if (context.is_shadow_pass) {
-    assert(context.shadow_caster);
+  // shadow casters outside of the view still cast shadows into it, they are culled against the light instead
+  const auto view_projection = context.is_shadow_pass
+                                   ? context.shadow_caster->light_space_matrix()
+                                   : context.camera->get_projection_matrix() * context.camera->get_view_matrix();
+  const Frustum frustum(view_projection);
 
-    gl::Shader* shader = &context.shadow_map->shader;
+  inside.resize(candidates.size());
+  frustum.test(candidate_bounds, inside.data());
 
-    shader->bind();
-    shader->uniform("u_Model", transform);
-    shader->uniform("u_LightSpaceMatrix", context.shadow_caster->light_space_matrix());
-  } else {
-    gl::Shader* shader = m_material->get_shader();
+  queue.clear();
+  for (size_t i = 0; i < candidates.size(); i++) {
+    if (inside[i]) candidates[i]->enqueue(queue, context);
+  }
 
-    shader->bind();
-    shader->uniform("u_Model", transform);
-    shader->uniform("u_View", context.camera->get_view_matrix());
-    shader->uniform("u_Projection", context.camera->get_projection_matrix());
+  queue.sort();
 
-    if (context.shadow_caster) {
-      shader->uniform("u_LightSpaceMatrix", context.shadow_caster->light_space_matrix());
-    }
+  // every item gets an instance at its index after sorting, so batches are ranges of the buffer
+  const auto& items = queue.get_items();
+  if (items.empty()) return;
 
-    shader->uniform("u_BackgroundColor", context.background_color);
-    shader->uniform("u_NumLights", static_cast<int>(context.lights.size()));
-    shader->uniform("u_CameraPosition", context.camera->get_world_position());
-    shader->uniform("u_ReceiveShadow", (receive_shadow && context.shadow_caster));
+  instances.resize(items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    const auto* object = items[i].object;
+    instances[i] = {object->transform, (object->receive_shadow && context.shadow_caster) ? 1.0f : 0.0f};
+  }
+  instance_buffer.buffer(instances, GL_STREAM_DRAW);
 
-    for (int i = 0; i < context.lights.size(); i++) {
-      auto index = std::to_string(i);
-      auto type = context.lights[i]->type;
+  queue.submit([&context, &items](const DrawBatch& batch) { items[batch.first].object->draw_queued(context, batch); });
 
-      shader->uniform("u_Lights[" + index + "].type", type);
-      shader->uniform("u_Lights[" + index + "].color", context.lights[i]->rgb);
-      shader->uniform("u_Lights[" + index + "].position", context.lights[i]->get_world_position());
-    }
+  // nothing that runs later should change the buffers of the last vertex array
+  glBindVertexArray(0);
+}
 
-    context.shadow_map->depth_map.bind(0);
-    shader->uniform("u_ShadowMap", 0);
+void Mesh::draw_self(RenderContext& context) {
+  // on its own, as the only instance in the buffer
+  const InstanceData instance = {transform, (receive_shadow && context.shadow_caster) ? 1.0f : 0.0f};
+  context.instance_buffer->buffer(&instance, sizeof(instance), GL_STREAM_DRAW);
 
-    m_material->bind();
-  }
+  draw_queued(context, DrawBatch{});
+  m_geometry->unbind();
+}
 
-  m_geometry->bind();
+BoundingSphere Mesh::get_local_bounds() const { return m_geometry->bounds; }
 
-  glDrawArrays(GL_TRIANGLES, 0, m_geometry->triangle_count);
-  m_geometry->unbind();
+void Mesh::enqueue(RenderQueue& queue, const RenderContext& context) {
+  const gl::Shader* shader = context.is_shadow_pass ? &context.shadow_map->shader : m_material->get_shader();
+  const DrawState state = {.shader = shader->id,
+                           .material = context.is_shadow_pass ? 0U : static_cast<uint32_t>(m_material->id),
+                           .geometry = m_geometry->get_id()};
 
-  draw_children(context);
+  const float depth = glm::length(get_world_position() - context.camera->get_world_position());
+  queue.push(this, RenderPass::OPAQUE, state, depth);
+}
+
+void Mesh::draw_queued(RenderContext& context, const DrawBatch& batch) {
+  if (context.is_shadow_pass) {
+    assert(context.shadow_caster);
+    if (batch.changes.shader) context.shadow_map->shader.bind();
+  } else {
+    gl::Shader* shader = m_material->get_shader();
+
+    if (batch.changes.shader) {
+      shader->bind();
+      context.shadow_map->depth_map.bind(0);
+      shader->uniform(m_material->get_uniforms()->shadow_map, 0);
+    }
+
+    if (batch.changes.material) m_material->bind();
+  }
+
+  if (batch.changes.geometry) {
+    m_geometry->bind();
+    m_geometry->set_instance_buffer(*context.instance_buffer);
+  }
+
+  glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, m_geometry->triangle_count, batch.count, batch.first);
 }
 
 ShadowMap::ShadowMap(unsigned int shadow_width, unsigned int shadow_height)
@@ -1080,21 +1300,11 @@ Billboard::Billboard(std::shared_ptr<gl::Texture> sprite, glm::vec3 color)
 void Billboard::draw_self(RenderContext& context) {
   if (context.is_shadow_pass) return;
 
-  auto camera = context.camera;
-
-  auto view = camera->get_view_matrix();
-  glm::vec3 up = {view[0][1], view[1][1], view[2][1]};
-  glm::vec3 right = {view[0][0], view[1][0], view[2][0]};
-
   shader.bind();
-  shader.uniform("u_View", view);
-  shader.uniform("u_Projection", camera->get_projection_matrix());
   shader.uniform("u_Texture", 5);
   shader.uniform("u_Color", color);
   shader.uniform("u_Position", get_world_position());
   shader.uniform("u_Scale", get_scale());
-  shader.uniform("u_Right", right);
-  shader.uniform("u_Up", up);
   texture->bind(5);
 
   vao.bind();
@@ -1112,6 +1322,13 @@ void Billboard::draw_self(RenderContext& context) {
   glDepthMask(GL_TRUE);
 }
 
+void Billboard::enqueue(RenderQueue& queue, const RenderContext& context) {
+  if (context.is_shadow_pass) return;
+
+  const float depth = glm::length(get_world_position() - context.camera->get_world_position());
+  queue.push(this, RenderPass::TRANSPARENT, {}, depth);
+}
+
 Skybox::Skybox(const std::array<std::string, 6>& faces)
     : Mesh(make_cube_geometry(1.0f), std::make_shared<SkyboxMaterial>(std::make_shared<gl::CubemapTexture>(faces))) {}
 
@@ -1122,10 +1339,7 @@ void Skybox::draw_self(RenderContext& context) {
     m_material->bind();
     gl::Shader* shader = m_material->get_shader();
 
-    auto u_View = glm::mat4(glm::mat3(context.camera->get_view_matrix()));
-    shader->uniform("u_View", u_View);
     shader->uniform("u_Model", transform);
-    shader->uniform("u_Projection", context.camera->get_projection_matrix());
 
     m_geometry->bind();
     glDrawArrays(GL_TRIANGLES, 0, m_geometry->triangle_count);
@@ -1134,6 +1348,10 @@ void Skybox::draw_self(RenderContext& context) {
   }
 }
 
+void Skybox::enqueue(RenderQueue& queue, const RenderContext& context) {
+  if (!context.is_shadow_pass) queue.push(this, RenderPass::BACKGROUND, {}, 0.0f);
+}
+
 void SkyboxMaterial::bind() {
   gl::Shader* shader = get_shader();
   int unit = 2;
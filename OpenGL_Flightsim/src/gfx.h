@@ -14,9 +14,13 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "frustum.h"
+#include "renderqueue.h"
+
 namespace gfx {
 
 constexpr float PI = 3.14159265359f;
@@ -41,6 +45,15 @@ constexpr RGB rgb(uint32_t hex) {
              static_cast<float>((hex & 0x0000ffU) >> 0) / 255.0f};
 }
 
+constexpr int MAX_LIGHTS = 4;  // same as in shaders/phong.frag, further lights are ignored
+
+// first vertex attribute of the per instance data, after position, normal and uv
+constexpr GLuint INSTANCE_ATTRIBUTE = 3;
+
+// binding points of the uniform blocks that are shared by all shaders
+constexpr GLuint FRAME_DATA_BINDING = 0;
+constexpr GLuint LIGHT_DATA_BINDING = 1;
+
 std::vector<float> load_obj(const std::string path);
 std::shared_ptr<Geometry> make_cube_geometry(float size);
 std::shared_ptr<Geometry> make_plane_geometry(int x_elements, int y_elements, float size);
@@ -48,20 +61,52 @@ std::shared_ptr<Geometry> make_plane_geometry(int x_elements, int y_elements, fl
 // gl primitives
 namespace gl {
 
+// location of a uniform, resolved once. -1 for uniforms the shader doesn't have, setting those does nothing
+struct UniformHandle {
+  GLint location = -1;
+};
+
 struct Shader {
   GLuint id;
   Shader(const std::string& path);
   Shader(const std::string& vertShader, const std::string& fragShader);
-  Shader(GLuint shader_id) : id(shader_id) {}
+  Shader(GLuint shader_id) : id(shader_id) { cache_uniforms(); }
   ~Shader();
   void bind() const;
   void unbind() const;
-  void uniform(const std::string& name, int value);
-  void uniform(const std::string& name, float value);
-  void uniform(const std::string& name, unsigned int value);
-  void uniform(const std::string& name, const glm::vec3& value);
-  void uniform(const std::string& name, const glm::vec4& value);
-  void uniform(const std::string& name, const glm::mat4& value);
+
+  // looked up in the cache that is filled after linking, names that aren't in it are asked from gl once
+  UniformHandle get_uniform(std::string_view name);
+
+  // connect a uniform block to a binding point, does nothing if the shader doesn't have the block
+  void uniform_block(const std::string& name, GLuint binding);
+
+  void uniform(UniformHandle handle, int value);
+  void uniform(UniformHandle handle, float value);
+  void uniform(UniformHandle handle, unsigned int value);
+  void uniform(UniformHandle handle, const glm::vec3& value);
+  void uniform(UniformHandle handle, const glm::vec4& value);
+  void uniform(UniformHandle handle, const glm::mat4& value);
+  void uniform(UniformHandle handle, const glm::vec4* values, int count);
+
+  void uniform(std::string_view name, int value);
+  void uniform(std::string_view name, float value);
+  void uniform(std::string_view name, unsigned int value);
+  void uniform(std::string_view name, const glm::vec3& value);
+  void uniform(std::string_view name, const glm::vec4& value);
+  void uniform(std::string_view name, const glm::mat4& value);
+  void uniform(std::string_view name, const glm::vec4* values, int count);
+
+ private:
+  // lookups by string_view without building a std::string
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+  };
+
+  std::unordered_map<std::string, GLint, NameHash, std::equal_to<>> m_uniforms;
+
+  void cache_uniforms();
 };
 
 struct VertexBuffer {
@@ -70,11 +115,26 @@ struct VertexBuffer {
   ~VertexBuffer();
   void bind() const;
   void unbind() const;
+  void buffer(const void* data, size_t size, GLenum usage = GL_STATIC_DRAW);
+
+  template <typename T>
+  void buffer(const std::vector<T>& data, GLenum usage = GL_STATIC_DRAW) {
+    buffer(&data[0], sizeof(data[0]) * data.size(), usage);
+  }
+};
+
+struct UniformBuffer {
+  GLuint id = 0;
+  UniformBuffer();
+  ~UniformBuffer();
+  void bind() const;
+  void unbind() const;
+  void bind_base(GLuint binding) const;
   void buffer(const void* data, size_t size);
 
   template <typename T>
-  void buffer(const std::vector<T>& data) {
-    buffer(&data[0], sizeof(data[0]) * data.size());
+  void buffer(const T& data) {
+    buffer(&data, sizeof(data));
   }
 };
 
@@ -127,8 +187,50 @@ struct CubemapTexture : public Texture {
   void bind(GLuint texture) const override;
   void unbind() const override;
 };
+
+// layers of the same size without mipmaps, filled a region at a time
+struct TextureArray : public Texture {
+  TextureArray(int width, int height, int layers, GLint internal_format, const TextureParams& params = {});
+  void bind(GLuint texture) const override;
+  void unbind() const override;
+  void update(int layer, int x, int y, int width, int height, GLenum format, GLenum type, const void* data);
+};
 };  // namespace gl
 
+// std140 layout of the uniform blocks in the shaders, vec3 take up 16 bytes
+struct FrameData {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 light_space_matrix;
+  glm::vec3 camera_position;
+  float padding0;
+  glm::vec3 background_color;
+  float padding1;
+};
+
+struct LightData {
+  struct Light {
+    int type;
+    int padding0[3];
+    glm::vec3 color;
+    float padding1;
+    glm::vec3 position;
+    float padding2;
+  };
+
+  int count;
+  int padding[3];
+  Light lights[MAX_LIGHTS];
+};
+
+static_assert(sizeof(FrameData) == 224 && sizeof(LightData) == 208, "must match std140");
+
+// vertex attributes of every mesh instance, streamed once per pass
+struct InstanceData {
+  glm::mat4 model;
+  float receive_shadow;
+};
+
 struct ShadowMap {
   ShadowMap(unsigned int shadow_width, unsigned int shadow_height);
   GLuint fbo;
@@ -145,6 +247,7 @@ struct RenderContext {
   std::vector<Light*> lights;
   bool is_shadow_pass;
   glm::vec3 background_color;
+  gl::VertexBuffer* instance_buffer;  // instances of the queued items in sorted order
 };
 
 class Object3D {
@@ -160,6 +263,7 @@ class Object3D {
   Object3D* parent;
   std::vector<Object3D*> children;
   glm::mat4 transform;
+  BoundingSphere world_bounds;  // updated with the transform
   bool receive_shadow = true;
   bool visible = true;
 
@@ -169,6 +273,14 @@ class Object3D {
   void draw_children(RenderContext& context);
   virtual void draw_self(RenderContext& context);
 
+  // in model space, objects without bounds are never culled
+  virtual BoundingSphere get_local_bounds() const { return {}; }
+
+  // add the object to the render queue, plain objects don't draw anything
+  virtual void enqueue(RenderQueue& queue, const RenderContext& context) {}
+  // draw a batch of the render queue, its changes tell what the previous batch left bound
+  virtual void draw_queued(RenderContext& context, const DrawBatch& batch) { draw_self(context); }
+
   void set_scale(const glm::vec3& scale);
   void set_rotation(const glm::vec3& rotation);
   void rotate_by(const glm::vec3& rotation);
@@ -194,6 +306,9 @@ class Object3D {
  protected:
   bool m_dirty_dof = false;
   bool m_dirty_transform = false;
+  bool m_dirty_bounds = true;
+
+  void update_world_bounds();
 
   glm::vec3 m_position;
   glm::vec3 m_scale;
@@ -249,18 +364,40 @@ class Geometry {
   ~Geometry();
   void bind();
   void unbind();
+  inline unsigned int get_id() const { return vao.id; }
+  // point the instance attributes of the vertex array at buffer, geometry has to be bound
+  void set_instance_buffer(const gl::VertexBuffer& buffer);
   int triangle_count;
 
+  // of the vertex positions, computed when the geometry is created
+  glm::vec3 min{0.0f}, max{0.0f};
+  BoundingSphere bounds;
+
  private:
+  GLuint m_instance_buffer = 0;
   unsigned int m_vao, m_vbo;
   gl::VertexBuffer vbo;
   gl::VertexArrayObject vao;
   static int get_stride(const VertexLayout& layout);
 };
 
+// uniforms that every mesh sets, resolved once per material shader so drawing doesn't look up names. the camera and
+// the lights are in the per frame uniform blocks, the model matrix is per instance
+struct MeshUniforms {
+  gl::UniformHandle shadow_map;
+
+  MeshUniforms(gl::Shader& shader);
+};
+
 class Material {
  public:
+  Material() : id(counter++) {}
+
+  const int id;
+  static int counter;
+
   virtual gl::Shader* get_shader() { return nullptr; }
+  virtual const MeshUniforms* get_uniforms() { return nullptr; }
   virtual void bind() {}
 };
 
@@ -268,10 +405,15 @@ template <class Derived>
 class MaterialX : public Material {
  public:
   MaterialX(const std::string& path) {
-    if (shader == nullptr) shader = std::make_shared<gl::Shader>(path);
+    if (shader == nullptr) {
+      shader = std::make_shared<gl::Shader>(path);
+      uniforms = std::make_shared<MeshUniforms>(*shader);
+    }
   }
   gl::Shader* get_shader() { return shader.get(); }
+  const MeshUniforms* get_uniforms() { return uniforms.get(); }
   static std::shared_ptr<gl::Shader> shader;
+  static std::shared_ptr<MeshUniforms> uniforms;
 };
 
 class Phong : public MaterialX<Phong> {
@@ -332,6 +474,10 @@ class Mesh : public Object3D {
   Mesh(std::shared_ptr<Geometry> geometry, std::shared_ptr<Material> material)
       : m_geometry(geometry), m_material(material) {}
   void draw_self(RenderContext& context) override;
+  BoundingSphere get_local_bounds() const override;
+  void enqueue(RenderQueue& queue, const RenderContext& context) override;
+  // all instances of the batch share the geometry and material of this mesh
+  void draw_queued(RenderContext& context, const DrawBatch& batch) override;
 
  protected:
   std::shared_ptr<Geometry> m_geometry;
@@ -342,6 +488,7 @@ class Billboard : public Object3D {
  public:
   Billboard(std::shared_ptr<gl::Texture> sprite, glm::vec3 color = glm::vec3(1.0f));
   void draw_self(RenderContext& context) override;
+  void enqueue(RenderQueue& queue, const RenderContext& context) override;
   Object3D& add(Object3D* child) = delete;
 
  private:
@@ -357,6 +504,9 @@ class Skybox : public Mesh {
  public:
   Skybox(const std::array<std::string, 6>& faces);
   void draw_self(RenderContext& context) override;
+  BoundingSphere get_local_bounds() const override { return {}; }  // always around the camera
+  void enqueue(RenderQueue& queue, const RenderContext& context) override;
+  void draw_queued(RenderContext& context, const DrawBatch& batch) override { draw_self(context); }
   Object3D& add(Object3D* child) = delete;
 };
 
@@ -391,6 +541,15 @@ class Renderer {
   unsigned int m_width, m_height;
   ShadowMap* shadow_map = nullptr;
   std::shared_ptr<Mesh> screen_quad;
+  gl::UniformBuffer frame_data, light_data;  // uploaded once per frame, shared by all shaders
+  RenderQueue queue;
+  std::vector<Object3D*> candidates;  // visible objects before culling
+  BoundsBatch candidate_bounds;
+  std::vector<uint8_t> inside;
+  std::vector<InstanceData> instances;
+  gl::VertexBuffer instance_buffer;
+
+  void draw_queue(Object3D& scene, RenderContext& context);
 };
 
 class FirstPersonController {
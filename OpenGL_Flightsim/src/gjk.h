@@ -0,0 +1,294 @@
+/*
+    Gjk intersection test and epa penetration depth between convex shapes given by support mappings
+    Christer_Ericson-Real-Time_Collision_Detection.pdf, chapter 9.5
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <limits>
+#include <vector>
+
+#include "collisions.h"
+#include "convexhull.h"
+
+namespace collisions {
+
+// convex hull placed in the world
+struct HullInstance {
+  const ConvexHull* hull;
+  glm::vec3 position;
+  glm::quat orientation;
+
+  inline glm::vec3 support(const glm::vec3& direction) const {
+    return position + orientation * hull->support(glm::conjugate(orientation) * direction);
+  }
+
+  inline Sphere get_bounding_sphere() const {
+    Sphere sphere;
+    sphere.center = position + orientation * hull->center, sphere.radius = hull->radius;
+    return sphere;
+  }
+};
+
+struct Penetration {
+  glm::vec3 normal;  // from a to b
+  float depth;
+  glm::vec3 point;  // deepest point of a inside b
+};
+
+namespace gjk {
+
+// vertex of the minkowski difference a - b, a is kept to recover contact points
+struct Vertex {
+  glm::vec3 point, a;
+};
+
+struct Simplex {
+  Vertex vertices[4];
+  int size = 0;
+
+  inline void push_front(const Vertex& vertex) {
+    for (int i = std::min(size, 3); i > 0; i--) vertices[i] = vertices[i - 1];
+    vertices[0] = vertex, size = std::min(size + 1, 4);
+  }
+};
+
+template <typename A, typename B>
+inline Vertex support(const A& a, const B& b, const glm::vec3& direction) {
+  const auto on_a = a.support(direction);
+  return {on_a - b.support(-direction), on_a};
+}
+
+inline bool same_direction(const glm::vec3& a, const glm::vec3& b) { return glm::dot(a, b) > 0.0f; }
+
+// the vertex that was added last is vertices[0], it is always part of the next simplex
+bool line(Simplex& s, glm::vec3& direction) {
+  const auto a = s.vertices[0].point, b = s.vertices[1].point;
+  const auto ab = b - a, ao = -a;
+
+  if (same_direction(ab, ao)) {
+    direction = glm::cross(glm::cross(ab, ao), ab);
+    // the origin is on the line
+    if (glm::dot(direction, direction) < EPSILON) direction = glm::cross(ab, glm::vec3(ab.y, ab.z, -ab.x));
+  } else {
+    s.size = 1, direction = ao;
+  }
+  return false;
+}
+
+bool triangle(Simplex& s, glm::vec3& direction) {
+  const auto a = s.vertices[0].point, b = s.vertices[1].point, c = s.vertices[2].point;
+  const auto ab = b - a, ac = c - a, ao = -a;
+  const auto abc = glm::cross(ab, ac);
+
+  if (same_direction(glm::cross(abc, ac), ao)) {
+    if (same_direction(ac, ao)) {
+      s.vertices[1] = s.vertices[2], s.size = 2;
+      direction = glm::cross(glm::cross(ac, ao), ac);
+      return false;
+    }
+    s.size = 2;
+    return line(s, direction);
+  }
+
+  if (same_direction(glm::cross(ab, abc), ao)) {
+    s.size = 2;
+    return line(s, direction);
+  }
+
+  if (same_direction(abc, ao)) {
+    direction = abc;
+  } else {
+    std::swap(s.vertices[1], s.vertices[2]);
+    direction = -abc;
+  }
+  return false;
+}
+
+bool tetrahedron(Simplex& s, glm::vec3& direction) {
+  const auto a = s.vertices[0].point, b = s.vertices[1].point, c = s.vertices[2].point, d = s.vertices[3].point;
+  const auto ab = b - a, ac = c - a, ad = d - a, ao = -a;
+  const auto abc = glm::cross(ab, ac), acd = glm::cross(ac, ad), adb = glm::cross(ad, ab);
+
+  if (same_direction(abc, ao)) {
+    s.size = 3;
+    return triangle(s, direction);
+  }
+  if (same_direction(acd, ao)) {
+    s.vertices[1] = s.vertices[2], s.vertices[2] = s.vertices[3], s.size = 3;
+    return triangle(s, direction);
+  }
+  if (same_direction(adb, ao)) {
+    s.vertices[2] = s.vertices[1], s.vertices[1] = s.vertices[3], s.size = 3;
+    return triangle(s, direction);
+  }
+  return true;
+}
+
+inline bool next(Simplex& s, glm::vec3& direction) {
+  switch (s.size) {
+    case 2:
+      return line(s, direction);
+    case 3:
+      return triangle(s, direction);
+    case 4:
+      return tetrahedron(s, direction);
+  }
+  return false;
+}
+
+// expand the tetrahedron that gjk ended with until its closest face to the origin lies on the boundary of the
+// minkowski difference
+template <typename A, typename B>
+Penetration expand(const A& a, const B& b, const Simplex& simplex) {
+  struct Face {
+    int v[3];
+    glm::vec3 normal;
+    float distance;
+  };
+
+  std::vector<Vertex> vertices(simplex.vertices, simplex.vertices + 4);
+  std::vector<Face> faces;
+  std::vector<std::pair<int, int>> edges;
+
+  auto add_face = [&](int i, int j, int k) {
+    const auto& p = vertices[i].point;
+    auto normal = glm::cross(vertices[j].point - p, vertices[k].point - p);
+    const float length = glm::length(normal);
+    if (length < EPSILON) return;
+
+    normal /= length;
+    float distance = glm::dot(normal, p);
+    // faces point away from the origin, which is inside the polytope
+    if (distance < 0.0f) normal = -normal, distance = -distance, std::swap(j, k);
+    faces.push_back({{i, j, k}, normal, distance});
+  };
+
+  add_face(0, 1, 2), add_face(0, 3, 1), add_face(0, 2, 3), add_face(1, 3, 2);
+
+  const float tolerance = 1e-4f;
+  int closest = 0;
+
+  for (int iteration = 0; iteration < 64 && !faces.empty(); iteration++) {
+    closest = 0;
+    for (int i = 1; i < static_cast<int>(faces.size()); i++) {
+      if (faces[i].distance < faces[closest].distance) closest = i;
+    }
+
+    const auto normal = faces[closest].normal;
+    const auto vertex = support(a, b, normal);
+    if (glm::dot(vertex.point, normal) - faces[closest].distance < tolerance) break;
+
+    // remove every face the new vertex sees and keep the edges on their boundary
+    edges.clear();
+    for (int i = 0; i < static_cast<int>(faces.size());) {
+      if (glm::dot(faces[i].normal, vertex.point - vertices[faces[i].v[0]].point) <= 0.0f) {
+        i++;
+        continue;
+      }
+
+      for (int e = 0; e < 3; e++) {
+        std::pair<int, int> edge(faces[i].v[e], faces[i].v[(e + 1) % 3]);
+        auto shared = std::find(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first));
+        if (shared != edges.end()) {
+          edges.erase(shared);
+        } else {
+          edges.push_back(edge);
+        }
+      }
+      faces[i] = faces.back();
+      faces.pop_back();
+    }
+
+    vertices.push_back(vertex);
+    const int index = static_cast<int>(vertices.size()) - 1;
+    for (const auto& edge : edges) add_face(edge.first, edge.second, index);
+  }
+
+  if (faces.empty()) return {glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, simplex.vertices[0].a};
+
+  closest = 0;
+  for (int i = 1; i < static_cast<int>(faces.size()); i++) {
+    if (faces[i].distance < faces[closest].distance) closest = i;
+  }
+  const auto& face = faces[closest];
+
+  // the projection of the origin onto the closest face, in barycentric coordinates
+  const auto p0 = vertices[face.v[0]].point, p1 = vertices[face.v[1]].point, p2 = vertices[face.v[2]].point;
+  const auto projection = face.normal * face.distance;
+  const auto v0 = p1 - p0, v1 = p2 - p0, v2 = projection - p0;
+  const float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1);
+  const float d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+  const float denominator = d00 * d11 - d01 * d01;
+
+  float v = 1.0f / 3.0f, w = 1.0f / 3.0f;
+  if (std::abs(denominator) > EPSILON) {
+    v = (d11 * d20 - d01 * d21) / denominator, w = (d00 * d21 - d01 * d20) / denominator;
+  }
+  const auto point = vertices[face.v[0]].a * (1.0f - v - w) + vertices[face.v[1]].a * v + vertices[face.v[2]].a * w;
+
+  return {face.normal, face.distance, point};
+}
+};  // namespace gjk
+
+// test collision between two convex shapes with support(direction) mappings, fills penetration if it isn't null
+template <typename A, typename B>
+bool test_collision(const A& a, const B& b, Penetration* penetration) {
+  gjk::Simplex simplex;
+  glm::vec3 direction = glm::vec3(1.0f, 0.0f, 0.0f);
+
+  simplex.push_front(gjk::support(a, b, direction));
+  direction = -simplex.vertices[0].point;
+
+  for (int iteration = 0; iteration < 64; iteration++) {
+    // the origin is on the simplex, touching counts but has no penetration direction
+    if (glm::dot(direction, direction) < EPSILON) {
+      if (penetration) *penetration = {glm::vec3(0.0f, 1.0f, 0.0f), 0.0f, simplex.vertices[0].a};
+      return true;
+    }
+
+    const auto vertex = gjk::support(a, b, direction);
+    if (glm::dot(vertex.point, direction) < 0.0f) return false;  // the origin is beyond the furthest point
+
+    simplex.push_front(vertex);
+    if (gjk::next(simplex, direction)) {
+      if (penetration) *penetration = gjk::expand(a, b, simplex);
+      return true;
+    }
+  }
+
+  // no decision, which only happens for degenerate shapes. a made up contact would stop both aircraft
+  return false;
+}
+
+// hulls of two compound shapes, only pairs whose bounding spheres overlap are tested with gjk. reports the deepest
+// penetration if penetration isn't null
+bool test_collision(const std::vector<ConvexHull>& hulls_a, const glm::vec3& position_a, const glm::quat& orientation_a,
+                    const std::vector<ConvexHull>& hulls_b, const glm::vec3& position_b, const glm::quat& orientation_b,
+                    Penetration* penetration) {
+  bool hit = false;
+  Penetration deepest{};
+
+  for (const auto& hull_a : hulls_a) {
+    const HullInstance a{&hull_a, position_a, orientation_a};
+    const auto sphere_a = a.get_bounding_sphere();
+
+    for (const auto& hull_b : hulls_b) {
+      const HullInstance b{&hull_b, position_b, orientation_b};
+      if (!test_collision(sphere_a, b.get_bounding_sphere())) continue;
+
+      Penetration current;
+      if (!test_collision(a, b, &current)) continue;
+
+      if (!hit || current.depth > deepest.depth) deepest = current;
+      hit = true;
+    }
+  }
+
+  if (hit && penetration) *penetration = deepest;
+  return hit;
+}
+};  // namespace collisions
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace jobs {
+
+// fixed set of worker threads consuming a shared task queue
+class ThreadPool {
+ public:
+  ThreadPool(unsigned int num_threads = default_thread_count()) {
+    for (unsigned int i = 0; i < std::max(1U, num_threads); i++) {
+      m_workers.emplace_back([this]() { work(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers) worker.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // queue a task, it will run on one of the worker threads
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+  }
+
+  // call func(i) for every i in [0, count) on the workers and the calling thread, returns once all calls are done.
+  // indices are handed out in chunks of `grain`, nothing is allocated. must not be called from inside a task.
+  template <typename Func>
+  void parallel_for(int count, Func&& func, int grain = 1) {
+    if (count <= 0) return;
+
+    Batch batch;
+    batch.count = count;
+    batch.grain = std::max(1, grain);
+    batch.context = &func;
+    batch.invoke = [](void* context, int index) { (*static_cast<std::remove_reference_t<Func>*>(context))(index); };
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_batch = &batch;
+    }
+    m_condition.notify_all();
+
+    run(batch);
+
+    // wait for workers that are still busy with their last chunk
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_batch = nullptr;
+    m_batch_done.wait(lock, [&batch]() { return batch.active_workers == 0; });
+  }
+
+  unsigned int size() const { return static_cast<unsigned int>(m_workers.size()); }
+
+  // leave one core for the thread that owns the pool
+  static unsigned int default_thread_count() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+  }
+
+ private:
+  struct Batch {
+    int count = 0, grain = 1;
+    int active_workers = 0;  // guarded by m_mutex
+    std::atomic<int> next{0};
+    void* context = nullptr;
+    void (*invoke)(void* context, int index) = nullptr;
+
+    bool exhausted() const { return next.load(std::memory_order_relaxed) >= count; }
+  };
+
+  bool m_quit = false;
+  Batch* m_batch = nullptr;
+  std::mutex m_mutex;
+  std::condition_variable m_condition, m_batch_done;
+  std::deque<std::function<void()>> m_tasks;
+  std::vector<std::thread> m_workers;
+
+  static void run(Batch& batch) {
+    for (;;) {
+      const int begin = batch.next.fetch_add(batch.grain, std::memory_order_relaxed);
+      if (begin >= batch.count) return;
+
+      const int end = std::min(begin + batch.grain, batch.count);
+      for (int i = begin; i < end; i++) batch.invoke(batch.context, i);
+    }
+  }
+
+  void work() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() {
+          return m_quit || !m_tasks.empty() || (m_batch != nullptr && !m_batch->exhausted());
+        });
+
+        // help with a running parallel_for before picking up queued tasks
+        if (m_batch != nullptr && !m_batch->exhausted()) {
+          Batch* batch = m_batch;
+          batch->active_workers++;
+          lock.unlock();
+
+          run(*batch);
+
+          lock.lock();
+          if (--batch->active_workers == 0) m_batch_done.notify_all();
+          continue;
+        }
+
+        if (m_quit && m_tasks.empty()) return;
+
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+};
+};  // namespace jobs
@@ -0,0 +1,119 @@
+/*
+    Landing gear, every wheel is a spring damper strut with tire friction against the terrain
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "phi.h"
+#include "terrain.h"
+
+struct Wheel {
+  glm::vec3 position;              // strut attachment in body space, m
+  float length = 1.0f;             // the wheel hangs this far below the attachment when the strut is extended, m
+  float stiffness = 200000.0f;     // N/m
+  float damping = 30000.0f;        // N/(m/s)
+  float rolling_friction = 0.02f;  // along the wheel
+  float brake_friction = 0.5f;     // along the wheel with full brakes
+  float lateral_friction = 0.8f;   // across the wheel
+
+  bool contact = false;      // touched the ground during the last sub step
+  float compression = 0.0f;  // of the strut during the last sub step, m
+};
+
+struct LandingGear {
+  std::vector<Wheel> wheels;
+  const terrain::TerrainField* terrain = nullptr;  // flat ground at y = 0 without a terrain
+  phi::Seconds max_substep = 0.001f;               // the struts are much stiffer than the aerodynamics
+  float brake = 0.0f;                              // [0, 1]
+
+  // integrate the rigid body over dt. forces that were already applied to the body are held constant over the
+  // sub steps, only the wheel contacts are evaluated again. away from the ground this is a single step
+  void update(phi::RigidBody& rigid_body, phi::Seconds dt) {
+    if (!near_ground(rigid_body, dt)) {
+      for (auto& wheel : wheels) wheel.contact = false, wheel.compression = 0.0f;
+      rigid_body.update(dt);
+      return;
+    }
+
+    const glm::vec3 force = rigid_body.get_force(), torque = rigid_body.get_torque();
+    const int substeps = std::max(1, static_cast<int>(std::ceil(dt / max_substep)));
+    const phi::Seconds h = dt / static_cast<float>(substeps);
+
+    for (int i = 0; i < substeps; i++) {
+      // the rigid body clears its accumulators after every step
+      if (i > 0) rigid_body.add_force(force), rigid_body.add_relative_torque(torque);
+
+      apply_forces(rigid_body);
+      rigid_body.update(h);
+    }
+  }
+
+ private:
+  // below this tire speed friction fades out linearly so resting aircraft don't jitter, m/s
+  static constexpr float SLIP_VELOCITY = 0.2f;
+
+  inline float get_ground_height(const glm::vec3& point) const {
+    return terrain ? terrain->get_height(point) : 0.0f;
+  }
+
+  inline glm::vec3 get_ground_normal(const glm::vec3& point) const {
+    return terrain ? terrain->get_surface_normal(glm::vec2(point.x, point.z)) : phi::UP;
+  }
+
+  // cheap test against the highest terrain around the aircraft
+  bool near_ground(const phi::RigidBody& rigid_body, phi::Seconds dt) const {
+    if (wheels.empty()) return false;
+
+    float reach = 0.0f;
+    for (const auto& wheel : wheels) reach = std::max(reach, glm::length(wheel.position) + wheel.length);
+    reach += rigid_body.get_speed() * dt;
+
+    const glm::vec2 center(rigid_body.position.x, rigid_body.position.z);
+    const float ground = terrain ? terrain->get_max_height(center - reach, center + reach) : 0.0f;
+    return rigid_body.position.y - reach <= ground;
+  }
+
+  void apply_forces(phi::RigidBody& rigid_body) {
+    const auto down = rigid_body.transform_direction(phi::DOWN);
+
+    for (auto& wheel : wheels) {
+      wheel.contact = false, wheel.compression = 0.0f;
+
+      // struts pointing sideways or up can't touch the ground
+      if (down.y > -0.1f) continue;
+
+      // distance from the attachment to the ground along the strut
+      const auto attachment = rigid_body.position + rigid_body.transform_direction(wheel.position);
+      const float distance = (attachment.y - get_ground_height(attachment)) / -down.y;
+      const float compression = wheel.length - distance;
+
+      if (compression <= 0.0f) continue;
+
+      const auto point = wheel.position + phi::DOWN * distance;  // body space
+      const auto velocity = rigid_body.transform_direction(rigid_body.get_point_velocity(point));
+      const auto normal = get_ground_normal(attachment);
+
+      // the strut only pushes
+      const float load = std::max(0.0f, wheel.stiffness * compression + wheel.damping * glm::dot(velocity, down));
+
+      auto forward = rigid_body.forward() - normal * glm::dot(rigid_body.forward(), normal);
+      if (glm::length(forward) < phi::EPSILON) continue;
+      forward = glm::normalize(forward);
+      const auto side = glm::cross(normal, forward);
+
+      const float along = glm::dot(velocity, forward), across = glm::dot(velocity, side);
+      const float friction = glm::mix(wheel.rolling_friction, wheel.brake_friction, brake);
+
+      auto force = normal * load;
+      force -= forward * (friction * load * along / std::max(std::abs(along), SLIP_VELOCITY));
+      force -= side * (wheel.lateral_friction * load * across / std::max(std::abs(across), SLIP_VELOCITY));
+
+      rigid_body.add_force_at_point(rigid_body.inverse_transform_direction(force), point);
+      wheel.contact = true, wheel.compression = compression;
+    }
+  }
+};
@@ -0,0 +1,183 @@
+/*
+    Fuel tanks and detachable stores, mass and inertia are updated incrementally as fuel burns and stores drop
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+#include "phi.h"
+
+struct FuelTank {
+  glm::vec3 position;     // body space, m
+  float capacity = 0.0f;  // kg
+  float fuel = 0.0f;      // kg
+  int order = 0;          // tanks with a higher order run dry first, tanks with the same order drain together
+};
+
+struct Store {
+  glm::vec3 position;    // body space, m
+  float mass = 0.0f;     // kg
+  glm::vec3 inertia{};   // principal moments about its own center, e.g. phi::inertia::cylinder()
+  bool attached = true;  // released stores no longer count
+};
+
+// mass and inertia of the aircraft as sums over its parts about the body origin. fuel and stores change these sums by
+// a single parallel axis term each, the tensor about the center of gravity and its inverse are only rebuilt at a low
+// rate. sums are kept in double so hours of small fuel burns don't drift
+class Loadout {
+ public:
+  phi::Seconds refresh_interval = 0.1f;  // between updates of the rigid body, s
+  float inverse_tolerance = 0.002f;      // relative change of the tensor before it is inverted again
+
+  Loadout() = default;
+
+  // empty aircraft, inertia about the center of gravity
+  Loadout(float mass, const glm::mat3& inertia, const glm::vec3& center_of_gravity = glm::vec3(0.0f)) {
+    add_mass(mass, center_of_gravity, inertia);
+  }
+
+  int add_tank(const FuelTank& tank) {
+    m_tanks.push_back(tank);
+    add_mass(tank.fuel, tank.position);
+    return static_cast<int>(m_tanks.size()) - 1;
+  }
+
+  int add_store(const Store& store) {
+    m_stores.push_back(store);
+    if (store.attached) add_mass(store.mass, store.position, phi::inertia::tensor(store.inertia));
+    return static_cast<int>(m_stores.size()) - 1;
+  }
+
+  // drain up to mass of fuel, returns the mass that was actually burned
+  float burn(float mass) {
+    float burned = 0.0f;
+
+    while (burned < mass) {
+      // fuel left in the tanks that are drained now
+      int order = std::numeric_limits<int>::min();
+      float available = 0.0f;
+      for (const auto& tank : m_tanks) {
+        if (tank.fuel <= 0.0f || tank.order < order) continue;
+        if (tank.order > order) order = tank.order, available = 0.0f;
+        available += tank.fuel;
+      }
+      if (available <= 0.0f) break;
+
+      // in proportion to their fuel, so symmetric tanks stay symmetric
+      const float fraction = std::min(1.0f, (mass - burned) / available);
+      for (auto& tank : m_tanks) {
+        if (tank.fuel <= 0.0f || tank.order != order) continue;
+
+        // the mass follows what the tank actually lost after rounding, so both stay in sync over many small burns
+        const float before = tank.fuel;
+        tank.fuel = fraction < 1.0f ? tank.fuel - tank.fuel * fraction : 0.0f;
+        burned += before - tank.fuel;
+        add_mass(tank.fuel - before, tank.position);
+      }
+
+      if (fraction < 1.0f) break;
+    }
+    return burned;
+  }
+
+  // drop a store, returns false if it was already gone
+  bool release(int index) {
+    auto& store = m_stores[index];
+    if (!store.attached) return false;
+
+    store.attached = false;
+    add_mass(-store.mass, store.position, phi::inertia::tensor(-store.inertia));
+    return true;
+  }
+
+  // index of the next attached store, -1 if there is none
+  int get_attached_store() const {
+    for (int i = 0; i < static_cast<int>(m_stores.size()); i++) {
+      if (m_stores[i].attached) return i;
+    }
+    return -1;
+  }
+
+  // aircraft without tanks never run out of fuel
+  inline bool has_fuel() const { return m_tanks.empty() || get_fuel() > 0.0f; }
+
+  float get_fuel() const {
+    float fuel = 0.0f;
+    for (const auto& tank : m_tanks) fuel += tank.fuel;
+    return fuel;
+  }
+
+  inline float get_mass() const { return static_cast<float>(m_mass); }
+
+  inline glm::vec3 get_center_of_gravity() const {
+    return m_mass > 0.0 ? glm::vec3(m_moment / m_mass) : glm::vec3(0.0f);
+  }
+
+  // inertia tensor about the center of gravity
+  glm::mat3 get_inertia() const {
+    if (m_mass <= 0.0) return glm::mat3(0.0f);
+
+    const glm::dvec3 c = m_moment / m_mass;
+    return glm::mat3(m_second_moment - m_mass * parallel_axis(c));
+  }
+
+  inline const std::vector<FuelTank>& get_tanks() const { return m_tanks; }
+  inline const std::vector<Store>& get_stores() const { return m_stores; }
+
+  // copy mass and inertia to the rigid body every refresh_interval if anything changed
+  void update(phi::RigidBody& rigid_body, phi::Seconds dt) {
+    m_timer += dt;
+    if (!m_changed || m_timer < refresh_interval) return;
+    m_timer = 0.0f, m_changed = false;
+    apply(rigid_body);
+  }
+
+  // copy mass and inertia to the rigid body now, the inverse is only refreshed if the tensor changed enough
+  void apply(phi::RigidBody& rigid_body) {
+    const auto inertia = get_inertia();
+    rigid_body.mass = get_mass();
+
+    float change = 0.0f, size = 0.0f;
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        change = std::max(change, std::abs(inertia[i][j] - m_inverted[i][j]));
+        size = std::max(size, std::abs(inertia[i][j]));
+      }
+    }
+
+    if (change > inverse_tolerance * size) {
+      rigid_body.set_inertia(inertia);
+      m_inverted = inertia;
+    } else {
+      rigid_body.inertia = inertia;
+    }
+  }
+
+ private:
+  double m_mass = 0.0;
+  glm::dvec3 m_moment{0.0};         // sum of mass * position
+  glm::dmat3 m_second_moment{0.0};  // inertia about the body origin
+  glm::mat3 m_inverted{0.0f};       // tensor the rigid body inverse was last computed from
+  phi::Seconds m_timer = 0.0f;
+  bool m_changed = false;
+
+  std::vector<FuelTank> m_tanks;
+  std::vector<Store> m_stores;
+
+  // inertia of a unit point mass at r about the origin
+  static glm::dmat3 parallel_axis(const glm::dvec3& r) {
+    return glm::dot(r, r) * glm::dmat3(1.0) - glm::outerProduct(r, r);
+  }
+
+  void add_mass(float mass, const glm::vec3& position, const glm::mat3& inertia = glm::mat3(0.0f)) {
+    const glm::dvec3 r(position);
+    m_mass += mass;
+    m_moment += static_cast<double>(mass) * r;
+    m_second_moment += glm::dmat3(inertia) + static_cast<double>(mass) * parallel_axis(r);
+    m_changed = true;
+  }
+};
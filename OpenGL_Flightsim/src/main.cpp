@@ -13,11 +13,25 @@
 #include "../lib/imgui/imgui_impl_opengl3.h"
 #include "../lib/imgui/imgui_impl_sdl2.h"
 #include "ai.h"
+#include "aircraft.h"
+#include "broadphase.h"
 #include "clipmap.h"
 #include "collisions.h"
+#include "collisions_test.h"
 #include "flightmodel.h"
+#include "frustum_test.h"
+#include "gjk.h"
 #include "gfx.h"
+#include "jobs.h"
+#include "missiles.h"
+#include "missiles_test.h"
+#include "pathfinding.h"
 #include "phi.h"
+#include "projectiles.h"
+#include "renderqueue_test.h"
+#include "terrain.h"
+#include "terrain_test.h"
+#include "tournament.h"
 
 using std::cout;
 using std::endl;
@@ -33,6 +47,9 @@ I       toggle wireframe terrain
 WASD    control pitch and roll
 EQ      control yaw
 JK      control thrust
+B       wheel brakes
+SPACE   fire the gun
+M       launch a missile at the aircraft closest to the nose, while any are left
 )";
 
 #define CLIPMAP 1
@@ -56,20 +73,60 @@ struct Joystick {
 struct GameObject {
   gfx::Mesh transform;
   Airplane airplane;
+  collisions::Sphere collider{{}, glm::vec3(0.0f), 6.0f};        // covers the airframe, rounds hit it
+  collisions::Sphere fuselage{{}, glm::vec3(0.0f), 0.8f};        // crashes into the terrain, above the wheel struts
+  glm::vec3 displacement{};                                      // during the last update
+  projectiles::Gun gun{.muzzle = glm::vec3(4.0f, 0.5f, -1.0f)};  // left of the cockpit
+  int hits = 0;                                                  // scored on other aircraft
+  int crashes = 0;                                               // into the terrain or other aircraft
 
   void update(float dt) {
+    const auto position = airplane.rigid_body.position;
     airplane.update(dt);
+    collider.center = fuselage.center = position, displacement = airplane.rigid_body.position - position;
     transform.set_transform(airplane.rigid_body.position, airplane.rigid_body.orientation);
   }
 };
 
 void get_keyboard_state(Joystick& joystick, phi::Seconds dt);
-void solve_constraints(phi::RigidBody& rigid_body);
 void apply_to_object3d(const phi::RigidBody& rigid_body, gfx::Object3D& object);
 
 int main(void) {
 #if RUN_COLLISION_UNITTESTS
-  collisions::run_unit_tests();
+  if (collisions::run_unit_tests() > 0) return 1;
+#endif
+
+#if RUN_FRUSTUM_UNITTESTS
+  if (gfx::run_frustum_tests() > 0) return 1;
+#endif
+
+#if RUN_RENDER_QUEUE_UNITTESTS
+  if (gfx::run_render_queue_tests() > 0) return 1;
+#endif
+
+#if RUN_MISSILE_UNITTESTS
+  if (missiles::run_unit_tests() > 0) return 1;
+#endif
+
+#if RUN_TERRAIN_UNITTESTS
+  if (terrain::run_unit_tests() > 0) return 1;
+#endif
+
+#if RUN_COLLISION_BENCHMARKS
+  collisions::run_benchmarks();
+  return 0;
+#endif
+
+#if RUN_TOURNAMENT
+  tournament::run_tournament();
+  return 0;
+#endif
+
+#if BUILD_TERRAIN_TILES
+  return terrain::build_tile_file(path + "terrain.tiles", path + "heightmap.png", path + "normalmap.png",
+                                  path + "terrain.png")
+             ? 0
+             : 1;
 #endif
 
   SDL_Init(SDL_INIT_EVERYTHING);
@@ -126,6 +183,8 @@ int main(void) {
   }
 
   auto fuselage_vertices = gfx::load_obj("assets/models/falcon.obj");
+  auto falcon_hulls = collisions::load_convex_hulls("assets/models/falcon.obj");
+  const float falcon_radius = collisions::get_bounding_radius(falcon_hulls);
 
   gfx::Renderer renderer(RESOLUTION.x, RESOLUTION.y);
 
@@ -162,39 +221,10 @@ int main(void) {
   scene.add(&clipmap);
 #endif
 
-  const float mass = 10000.0f;
-  const float thrust = 50000.0f;
-
-  const float wing_offset = -1.0f;
-  const float tail_offset = -6.6f;
-
-  std::vector<phi::inertia::Element> masses = {
-      phi::inertia::cube({wing_offset, 0.0f, -2.7f}, {6.96f, 0.10f, 3.50f}, mass * 0.25f),  // left wing
-      phi::inertia::cube({wing_offset, 0.0f, +2.7f}, {6.96f, 0.10f, 3.50f}, mass * 0.25f),  // right wing
-      phi::inertia::cube({tail_offset, -0.1f, 0.0f}, {6.54f, 0.10f, 2.70f}, mass * 0.1f),   // elevator
-      phi::inertia::cube({tail_offset, 0.0f, 0.0f}, {5.31f, 3.10f, 0.10f}, mass * 0.1f),    // rudder
-      phi::inertia::cube({0.0f, 0.0f, 0.0f}, {8.0f, 2.0f, 2.0f}, mass * 0.5f),              // fuselage
-  };
-
-  auto inertia = phi::inertia::tensor(masses, true);
-
-  const Airfoil NACA_0012(NACA_0012_data);
-  const Airfoil NACA_2412(NACA_2412_data);
-  const Airfoil NACA_64_206(NACA_64_206_data);
-
-  std::vector<Wing> wings = {
-      Wing({wing_offset, 0.0f, -2.7f}, 6.96f, 2.50f, &NACA_64_206),           // left wing
-      Wing({wing_offset - 1.5f, 0.0f, -2.0f}, 3.80f, 1.26f, &NACA_0012),      // left aileron
-      Wing({wing_offset - 1.5f, 0.0f, 2.0f}, 3.80f, 1.26f, &NACA_0012),       // right aileron
-      Wing({wing_offset, 0.0f, +2.7f}, 6.96f, 2.50f, &NACA_64_206),           // right wing
-      Wing({tail_offset, -0.1f, 0.0f}, 6.54f, 2.70f, &NACA_0012),             // elevator
-      Wing({tail_offset, 0.0f, 0.0f}, 5.31f, 3.10f, &NACA_0012, phi::RIGHT),  // rudder
-  };
-
+  jobs::ThreadPool thread_pool;
   std::vector<GameObject*> objects;
 
-  GameObject player = {.transform = gfx::Mesh(f16_fuselage, f16_texture),
-                       .airplane = Airplane(mass, thrust, inertia, wings)};
+  GameObject player = {.transform = gfx::Mesh(f16_fuselage, f16_texture), .airplane = make_falcon()};
 
   player.airplane.rigid_body.position = glm::vec3(-7000.0f, 3000.0f, 0.0f);
   player.airplane.rigid_body.velocity = glm::vec3(phi::units::meter_per_second(600.0f), 0.0f, 0.0f);
@@ -203,13 +233,43 @@ int main(void) {
 
 #define NPC_AIRCRAFT 1
 #if NPC_AIRCRAFT
-  GameObject npc = {.transform = gfx::Mesh(f16_fuselage, f16_texture),
-                    .airplane = Airplane(mass, thrust, inertia, wings)};
+  GameObject npc = {.transform = gfx::Mesh(f16_fuselage, f16_texture), .airplane = make_falcon()};
 
   npc.airplane.rigid_body.position = glm::vec3(-6800.0f, 3020.0f, 50.0f);
   npc.airplane.rigid_body.velocity = glm::vec3(phi::units::meter_per_second(600.0f), 0.0f, 0.0f);
   scene.add(&npc.transform);
   objects.push_back(&npc);
+
+  Navigator navigator;
+#if CLIPMAP
+  // plan npc routes around the terrain on a 500 m grid
+  auto height_grid = std::make_shared<pathfinding::HeightGrid>(
+      [&clipmap](const glm::vec2& coords) { return clipmap.get_terrain_height(coords); }, glm::vec2(-25000.0f),
+      glm::vec2(25000.0f), 500.0f);
+  pathfinding::Planner planner(height_grid, thread_pool);
+  navigator.planner = &planner;
+#endif
+#endif
+
+  std::vector<collisions::Sphere> colliders(objects.size());
+  std::vector<glm::vec3> displacements(objects.size());
+  std::vector<missiles::Track> tracks(objects.size());
+
+  // proxy ids are the object indices
+  collisions::SweepAndPrune broadphase;
+  for (auto obj : objects) broadphase.add(collisions::get_swept_box(obj->collider, glm::vec3(0.0f)));
+
+#if CLIPMAP
+  for (auto obj : objects) obj->airplane.gear.terrain = &clipmap.get_terrain();
+
+  projectiles::ProjectileSystem projectiles({}, &clipmap.get_terrain());
+  missiles::MissileSystem missiles({}, &clipmap.get_terrain(), &thread_pool);
+  std::vector<collisions::Sphere> fuselages(objects.size());
+  std::vector<terrain::Contact> contacts(objects.size());
+  std::vector<uint8_t> hits(objects.size());
+#else
+  projectiles::ProjectileSystem projectiles;
+  missiles::MissileSystem missiles({}, nullptr, &thread_pool);
 #endif
 
 #if 1
@@ -290,6 +350,15 @@ int main(void) {
 #endif
               break;
 
+            case SDLK_m: {
+              auto& loadout = player.airplane.loadout;
+              const auto& rb = player.airplane.rigid_body;
+              const int store = loadout.get_attached_store();
+              const int target = missiles.lock_on(rb, 0, tracks.data(), static_cast<int>(tracks.size()));
+              if (store >= 0 && target >= 0 && missiles.launch(rb, 0, target)) loadout.release(store);
+              break;
+            }
+
             default:
               break;
           }
@@ -353,7 +422,7 @@ int main(void) {
     float ias = phi::units::kilometer_per_hour(get_indicated_air_speed(rb));
 
     ImGui::SetNextWindowPos(ImVec2(10, 10));
-    ImGui::SetNextWindowSize(ImVec2(145, 140));
+    ImGui::SetNextWindowSize(ImVec2(145, 189));
     ImGui::SetNextWindowBgAlpha(0.35f);
     ImGui::Begin("Flightsim", nullptr, window_flags);
     ImGui::Text("ALT:   %.2f m", rb.position.y);
@@ -364,8 +433,11 @@ int main(void) {
 #endif
     ImGui::Text("IAS:   %.2f km/h", ias);
     ImGui::Text("THR:   %d %%", static_cast<int>(player.airplane.engine.throttle * 100.0f));
+    ImGui::Text("FUEL:  %.0f kg", player.airplane.loadout.get_fuel());
     ImGui::Text("Mach:  %.2f", get_mach_number(rb));
     ImGui::Text("G:     %.1f", get_g_force(rb));
+    ImGui::Text("HITS:  %d", player.hits);
+    ImGui::Text("CRASH: %d", player.crashes);
     ImGui::Text("FPS:   %.2f", fps);
     ImGui::End();
 #endif
@@ -375,9 +447,11 @@ int main(void) {
     auto& player_aircraft = player.airplane;
     player_aircraft.joystick = glm::vec3(joystick.aileron, joystick.rudder, joystick.elevator);
     player_aircraft.engine.throttle = joystick.throttle;
+    player_aircraft.gear.brake = SDL_GetKeyboardState(NULL)[SDL_SCANCODE_B] ? 1.0f : 0.0f;
+    player.gun.trigger = SDL_GetKeyboardState(NULL)[SDL_SCANCODE_SPACE];
 
 #if NPC_AIRCRAFT
-    fly_towards(npc.airplane, player.airplane.rigid_body.position);
+    navigator.fly_towards(npc.airplane, player.airplane.rigid_body.position);
     // fly_towards(player.aircraft, npc.aircraft.rigid_body.position);
 #endif
 
@@ -385,6 +459,66 @@ int main(void) {
       for (auto obj : objects) {
         obj->update(dt);
       }
+
+      for (size_t i = 0; i < objects.size(); i++) {
+        const auto& rb = objects[i]->airplane.rigid_body;
+        colliders[i] = objects[i]->collider, displacements[i] = objects[i]->displacement;
+        tracks[i] = {rb.position, rb.velocity, rb.active};
+      }
+
+      // mid air collisions, the hulls are only tested for aircraft whose swept bounds overlap
+      for (size_t i = 0; i < objects.size(); i++) {
+        const auto bounds = collisions::Sphere{{}, colliders[i].center, falcon_radius};
+        broadphase.update(static_cast<int>(i), bounds, displacements[i]);
+      }
+
+      for (const auto& pair : broadphase.find_pairs()) {
+        auto &a = objects[pair.a]->airplane.rigid_body, &b = objects[pair.b]->airplane.rigid_body;
+        if (!a.active || !b.active) continue;
+
+        collisions::Penetration penetration;
+        if (!collisions::test_collision(falcon_hulls, a.position, a.orientation, falcon_hulls, b.position,
+                                        b.orientation, &penetration)) {
+          continue;
+        }
+
+        objects[pair.a]->crashes++, objects[pair.b]->crashes++;
+        for (auto rb : {&a, &b}) rb->velocity = rb->angular_velocity = glm::vec3(0.0f), rb->active = false;
+      }
+
+#if CLIPMAP
+      // aircraft that hit the terrain stop where they hit it, wrecks stay in contact and are only counted once.
+      // aircraft standing on their wheels keep the fuselage off the ground
+      for (size_t i = 0; i < objects.size(); i++) fuselages[i] = objects[i]->fuselage;
+      clipmap.get_terrain().sweep(fuselages.data(), displacements.data(), static_cast<int>(objects.size()),
+                                  contacts.data(), hits.data());
+
+      for (size_t i = 0; i < objects.size(); i++) {
+        auto& rb = objects[i]->airplane.rigid_body;
+        if (!hits[i] || !rb.active) continue;
+
+        objects[i]->crashes++;
+        rb.position = fuselages[i].center + displacements[i] * contacts[i].t;
+        rb.velocity = rb.angular_velocity = glm::vec3(0.0f);
+        rb.active = false;
+      }
+#endif
+
+      // rounds fired during this step start moving with the next one
+      projectiles.update(dt);
+      const int target_count = static_cast<int>(objects.size());
+      for (const auto& hit : projectiles.collide(colliders.data(), displacements.data(), target_count)) {
+        objects[hit.owner]->hits++;
+      }
+
+      for (const auto& detonation : missiles.update(dt, tracks.data(), static_cast<int>(tracks.size()))) {
+        if (detonation.target >= 0) objects[detonation.owner]->hits++;
+      }
+
+      for (size_t i = 0; i < objects.size(); i++) {
+        const auto& rb = objects[i]->airplane.rigid_body;
+        if (rb.active) projectiles.fire(objects[i]->gun, rb, static_cast<int>(i), dt);
+      }
     }
 
     fpm.set_position(glm::normalize(player_aircraft.rigid_body.get_body_velocity()) * projection_distance);
@@ -456,9 +590,3 @@ void get_keyboard_state(Joystick& joystick, phi::Seconds dt) {
 void apply_to_object3d(const phi::RigidBody& rigid_body, gfx::Object3D& object3d) {
   object3d.set_transform(rigid_body.position, rigid_body.orientation);
 }
-
-void solve_constraints(phi::RigidBody& rigid_body) {
-  if (rigid_body.position.y <= 0) {
-    rigid_body.position.y = 0, rigid_body.velocity.y = 0;
-  }
-}
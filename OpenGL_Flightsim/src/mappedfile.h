@@ -0,0 +1,45 @@
+/*
+    Read only memory mapping of a whole file. the platform code lives in mappedfile.cpp so windows.h and its macros
+    stay out of every file that includes this one
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+ public:
+  MappedFile() = default;
+
+  // files that can't be mapped leave it empty
+  explicit MappedFile(const std::string& path);
+
+  ~MappedFile() { unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept : m_data(other.m_data), m_size(other.m_size) {
+    other.m_data = nullptr, other.m_size = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      m_data = other.m_data, m_size = other.m_size;
+      other.m_data = nullptr, other.m_size = 0;
+    }
+    return *this;
+  }
+
+  inline bool empty() const { return m_data == nullptr; }
+  inline const uint8_t* data() const { return m_data; }
+  inline size_t size() const { return m_size; }
+
+ private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+
+  void unmap();
+};
@@ -0,0 +1,149 @@
+/*
+    Mass, center of gravity and inertia tensor of closed triangle meshes with the divergence theorem
+    https://www.geometrictools.com/Documentation/PolyhedralMassProperties.pdf
+*/
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "convexhull.h"
+#include "jobs.h"
+#include "phi.h"
+
+namespace phi {
+namespace inertia {
+
+struct MassProperties {
+  float mass = 0.0f;
+  glm::vec3 center_of_gravity{};
+  glm::mat3 tensor{0.0f};  // about the center of gravity
+};
+
+namespace mesh {
+
+// volume integrals of 1, x, y, z, x^2, y^2, z^2, xy, yz, zx over a solid, without the constant factors
+using Integrals = std::array<double, 10>;
+
+inline void subexpressions(double w0, double w1, double w2, double& f1, double& f2, double& f3, double& g0,
+                           double& g1, double& g2) {
+  const double temp0 = w0 + w1, temp1 = w0 * w0, temp2 = temp1 + w1 * temp0;
+  f1 = temp0 + w2;
+  f2 = temp2 + w2 * f1;
+  f3 = w0 * temp1 + w1 * temp2 + w2 * f2;
+  g0 = f2 + w0 * (f1 + w0);
+  g1 = f2 + w1 * (f1 + w1);
+  g2 = f2 + w2 * (f1 + w2);
+}
+
+// surface integral of one counter clockwise (seen from outside) triangle, added to integrals
+inline void add_triangle(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, Integrals& integrals) {
+  const double x0 = p0.x, y0 = p0.y, z0 = p0.z, x1 = p1.x, y1 = p1.y, z1 = p1.z, x2 = p2.x, y2 = p2.y, z2 = p2.z;
+  const double a1 = x1 - x0, b1 = y1 - y0, c1 = z1 - z0, a2 = x2 - x0, b2 = y2 - y0, c2 = z2 - z0;
+  const double d0 = b1 * c2 - b2 * c1, d1 = a2 * c1 - a1 * c2, d2 = a1 * b2 - a2 * b1;
+
+  double f1x, f2x, f3x, g0x, g1x, g2x, f1y, f2y, f3y, g0y, g1y, g2y, f1z, f2z, f3z, g0z, g1z, g2z;
+  subexpressions(x0, x1, x2, f1x, f2x, f3x, g0x, g1x, g2x);
+  subexpressions(y0, y1, y2, f1y, f2y, f3y, g0y, g1y, g2y);
+  subexpressions(z0, z1, z2, f1z, f2z, f3z, g0z, g1z, g2z);
+
+  integrals[0] += d0 * f1x;
+  integrals[1] += d0 * f2x, integrals[2] += d1 * f2y, integrals[3] += d2 * f2z;
+  integrals[4] += d0 * f3x, integrals[5] += d1 * f3y, integrals[6] += d2 * f3z;
+  integrals[7] += d0 * (y0 * g0x + y1 * g1x + y2 * g2x);
+  integrals[8] += d1 * (z0 * g0y + z1 * g1y + z2 * g2y);
+  integrals[9] += d2 * (x0 * g0z + x1 * g1z + x2 * g2z);
+}
+
+// integrals of a whole part, triangles are split into chunks over the pool if there is one. chunks are summed in a
+// fixed order so the result doesn't depend on the number of threads
+Integrals integrate(const collisions::hull::Part& part, jobs::ThreadPool* pool = nullptr) {
+  const int chunk_size = 1024;
+  const int count = static_cast<int>(part.triangles.size());
+  const int chunks = (count + chunk_size - 1) / chunk_size;
+  std::vector<Integrals> sums(chunks, Integrals{});
+
+  auto sum = [&](int chunk) {
+    const int end = std::min(count, (chunk + 1) * chunk_size);
+    for (int i = chunk * chunk_size; i < end; i++) {
+      const auto& v = part.triangles[i].v;
+      add_triangle(part.positions[v[0]], part.positions[v[1]], part.positions[v[2]], sums[chunk]);
+    }
+  };
+
+  if (pool) {
+    pool->parallel_for(chunks, sum);
+  } else {
+    for (int i = 0; i < chunks; i++) sum(i);
+  }
+
+  const double factors[10] = {1.0 / 6.0,  1.0 / 24.0, 1.0 / 24.0,  1.0 / 24.0,  1.0 / 60.0,
+                              1.0 / 60.0, 1.0 / 60.0, 1.0 / 120.0, 1.0 / 120.0, 1.0 / 120.0};
+
+  Integrals result{};
+  for (const auto& chunk : sums) {
+    for (int i = 0; i < 10; i++) result[i] += chunk[i];
+  }
+  for (int i = 0; i < 10; i++) result[i] *= factors[i];
+
+  // parts wound the other way have a negative volume
+  if (result[0] < 0.0) {
+    for (auto& integral : result) integral = -integral;
+  }
+  return result;
+}
+};  // namespace mesh
+
+// mass properties of a solid made of closed meshes with a density each, kg/m^3. parts without a density use the last
+// one, a single density is enough for a uniform solid
+MassProperties from_mesh(const std::vector<collisions::hull::Part>& parts, const std::vector<float>& densities,
+                         jobs::ThreadPool* pool = nullptr) {
+  mesh::Integrals total{};
+
+  for (size_t i = 0; i < parts.size(); i++) {
+    const double density = densities.empty() ? 1.0 : densities[std::min(i, densities.size() - 1)];
+    const auto integrals = mesh::integrate(parts[i], pool);
+    for (int j = 0; j < 10; j++) total[j] += density * integrals[j];
+  }
+
+  MassProperties result;
+  const double mass = total[0];
+  if (mass <= 0.0) return result;
+
+  const double cx = total[1] / mass, cy = total[2] / mass, cz = total[3] / mass;
+
+  // moments about the origin moved to the center of gravity with the parallel axis theorem
+  const double xx = total[5] + total[6] - mass * (cy * cy + cz * cz);
+  const double yy = total[4] + total[6] - mass * (cz * cz + cx * cx);
+  const double zz = total[4] + total[5] - mass * (cx * cx + cy * cy);
+  const double xy = -(total[7] - mass * cx * cy);
+  const double yz = -(total[8] - mass * cy * cz);
+  const double xz = -(total[9] - mass * cz * cx);
+
+  result.mass = static_cast<float>(mass);
+  result.center_of_gravity = glm::vec3(cx, cy, cz);
+  result.tensor = glm::mat3(xx, xy, xz, xy, yy, yz, xz, yz, zz);
+  return result;
+}
+
+// same shape with the density scaled to reach the given mass
+inline MassProperties with_mass(const MassProperties& properties, float mass) {
+  MassProperties result = properties;
+  if (properties.mass <= 0.0f) return result;
+
+  result.mass = mass;
+  result.tensor = properties.tensor * (mass / properties.mass);
+  return result;
+}
+
+// mass properties of an obj model, every object in the file is a part
+inline MassProperties from_mesh(const std::string& path, const std::vector<float>& densities,
+                                jobs::ThreadPool* pool = nullptr) {
+  return from_mesh(collisions::hull::load_obj_parts(path), densities, pool);
+}
+};  // namespace inertia
+};  // namespace phi
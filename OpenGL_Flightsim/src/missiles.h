@@ -0,0 +1,231 @@
+/*
+    Guided missiles as point masses with a boost phase, drag and proportional navigation, updated in batches
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "flightmodel.h"
+#include "jobs.h"
+#include "phi.h"
+#include "terrain.h"
+
+#define RUN_MISSILE_UNITTESTS 0
+
+namespace missiles {
+
+// roughly a short range heat seeker
+struct MissileParams {
+  int capacity = 64;                         // missiles in flight, nothing is allocated after construction
+  float mass = 85.0f;                        // at launch, kg
+  float burnout_mass = 60.0f;                // after the motor burned out, kg
+  float thrust = 18000.0f;                   // N
+  phi::Seconds burn_time = 5.0f;             // s
+  float drag_coefficient = 0.4f;             // of the body
+  float area = 0.0127f;                      // cross section, m^2
+  float navigation_constant = 4.0f;          // proportional navigation gain, usually 3-5
+  float max_acceleration = 350.0f;           // lateral, m/s^2
+  float gimbal_limit = glm::radians(60.0f);  // seeker loses the target beyond this angle off the nose
+  float fuse_radius = 8.0f;                  // proximity fuse, m
+  phi::Seconds lifetime = 20.0f;             // self destruct, s
+  float guidance_rate = 200.0f;              // guidance updates per second, Hz
+};
+
+// state of the missile targets at the start of the step, targets are assumed to fly straight during the step
+struct Track {
+  glm::vec3 position, velocity;
+  bool active = true;  // crashed targets can't be locked on to
+};
+
+struct Missile {
+  glm::vec3 position, velocity;
+  int owner, target;  // target is -1 once the seeker lost it
+  phi::Seconds age = 0.0f;
+};
+
+struct Detonation {
+  int owner, target;  // target is -1 if the missile missed
+  glm::vec3 point;
+};
+
+// relative position and velocity of the target, the same deltas get_intercept_point() works with
+struct Engagement {
+  glm::vec3 range, closing_velocity;
+
+  Engagement(const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& target_position,
+             const glm::vec3& target_velocity)
+      : range(target_position - position), closing_velocity(target_velocity - velocity) {}
+
+  // rotation rate of the line of sight, rad/s
+  inline glm::vec3 get_line_of_sight_rate() const {
+    return glm::cross(range, closing_velocity) / std::max(glm::dot(range, range), phi::EPSILON);
+  }
+};
+
+// commanded acceleration, perpendicular to the velocity of the missile
+inline glm::vec3 get_proportional_navigation(const Engagement& engagement, const glm::vec3& velocity,
+                                             float navigation_constant) {
+  return navigation_constant * glm::cross(engagement.get_line_of_sight_rate(), velocity);
+}
+
+class MissileSystem {
+ public:
+  MissileSystem(const MissileParams& missile_params = {}, const terrain::TerrainField* terrain_field = nullptr,
+                jobs::ThreadPool* thread_pool = nullptr)
+      : params(missile_params), terrain(terrain_field), pool(thread_pool) {
+    m_missiles.reserve(params.capacity);
+    m_results.reserve(params.capacity);
+    m_detonations.reserve(params.capacity);
+  }
+
+  // launch from the nose of the shooter, returns false if all missiles are already in flight
+  bool launch(const phi::RigidBody& shooter, int owner, int target) {
+    if (static_cast<int>(m_missiles.size()) >= params.capacity) return false;
+
+    m_missiles.push_back({.position = shooter.position + shooter.forward() * 6.0f,
+                          .velocity = shooter.velocity + shooter.forward() * 10.0f,
+                          .owner = owner,
+                          .target = target});
+    return true;
+  }
+
+  // the active track closest to the nose of the shooter inside the seeker limits, -1 if there is none
+  int lock_on(const phi::RigidBody& shooter, int owner, const Track* tracks, int track_count) const {
+    int target = -1;
+    float best = std::cos(params.gimbal_limit);
+
+    for (int i = 0; i < track_count; i++) {
+      const auto range = tracks[i].position - shooter.position;
+      if (i == owner || !tracks[i].active || glm::length(range) < phi::EPSILON) continue;
+
+      const float alignment = glm::dot(shooter.forward(), glm::normalize(range));
+      if (alignment > best) target = i, best = alignment;
+    }
+    return target;
+  }
+
+  // fly every missile for dt, split over the pool if there is one. missiles that detonated near their target,
+  // hit the terrain or ran out of time are removed and reported
+  const std::vector<Detonation>& update(phi::Seconds dt, const Track* tracks, int track_count) {
+    m_detonations.clear();
+
+    const int count = static_cast<int>(m_missiles.size());
+    m_results.resize(count);
+
+    // the guidance runs at a fixed rate, the frame rate only decides how many guidance steps there are per update
+    const int substeps = std::max(1, static_cast<int>(std::ceil(dt * params.guidance_rate)));
+    const phi::Seconds h = dt / static_cast<float>(substeps);
+
+    auto guide = [&](int i) { m_results[i] = fly(m_missiles[i], h, substeps, tracks, track_count); };
+
+    if (pool) {
+      pool->parallel_for(count, guide, 4);
+    } else {
+      for (int i = 0; i < count; i++) guide(i);
+    }
+
+    // back to front so removing a missile doesn't move one that hasn't been looked at
+    for (int i = count - 1; i >= 0; i--) {
+      if (!m_results[i].done) continue;
+
+      m_detonations.push_back({m_missiles[i].owner, m_results[i].target, m_results[i].point});
+      m_missiles[i] = m_missiles.back();
+      m_missiles.pop_back();
+    }
+
+    return m_detonations;
+  }
+
+  inline const std::vector<Missile>& get_missiles() const { return m_missiles; }
+
+  const MissileParams params;
+  const terrain::TerrainField* terrain;  // missiles below it are destroyed, flat ground at y = 0 without one
+  jobs::ThreadPool* pool;
+
+ private:
+  struct Result {
+    bool done;
+    int target;
+    glm::vec3 point;
+  };
+
+  std::vector<Missile> m_missiles;
+  std::vector<Result> m_results;
+  std::vector<Detonation> m_detonations;
+
+  inline float get_ground_height(const glm::vec3& point) const {
+    return terrain ? terrain->get_height(point) : 0.0f;
+  }
+
+  // runs on the workers, only touches the missile
+  Result fly(Missile& missile, phi::Seconds h, int substeps, const Track* tracks, int track_count) const {
+    const float mass_flow = (params.mass - params.burnout_mass) / params.burn_time;
+
+    // the target was removed or crashed since the last update, wrecks are not chased
+    if (missile.target >= track_count || (missile.target >= 0 && !tracks[missile.target].active)) missile.target = -1;
+
+    for (int step = 0; step < substeps; step++) {
+      const auto start = missile.position;
+      const float speed = glm::length(missile.velocity);
+      const auto direction = speed > phi::EPSILON ? missile.velocity / speed : phi::FORWARD;
+
+      glm::vec3 target_position{}, target_velocity{};
+      glm::vec3 acceleration = phi::DOWN * phi::EARTH_GRAVITY;
+
+      if (missile.target >= 0) {
+        const auto& track = tracks[missile.target];
+        target_velocity = track.velocity;
+        target_position = track.position + track.velocity * (h * static_cast<float>(step));
+
+        const Engagement engagement(missile.position, missile.velocity, target_position, target_velocity);
+
+        if (glm::dot(direction, glm::normalize(engagement.range)) < std::cos(params.gimbal_limit)) {
+          missile.target = -1;
+        } else {
+          auto command = get_proportional_navigation(engagement, missile.velocity, params.navigation_constant);
+          command -= direction * glm::dot(command, direction);
+
+          const float magnitude = glm::length(command);
+          if (magnitude > params.max_acceleration) command *= params.max_acceleration / magnitude;
+          acceleration += command;
+        }
+      }
+
+      const bool burning = missile.age < params.burn_time;
+      const float mass = burning ? params.mass - mass_flow * missile.age : params.burnout_mass;
+      const float air_density = get_air_density(glm::clamp(missile.position.y, 0.0f, 11000.0f));
+      const float drag = 0.5f * air_density * speed * speed * params.drag_coefficient * params.area;
+
+      acceleration += direction * (((burning ? params.thrust : 0.0f) - drag) / mass);
+
+      missile.velocity += acceleration * h;
+      missile.position += missile.velocity * h;
+      missile.age += h;
+
+      // proximity fuse, closest approach to the target during the sub step
+      if (missile.target >= 0) {
+        const auto relative = (missile.position - start) - target_velocity * h;
+        const auto offset = start - target_position;
+        const float length2 = glm::dot(relative, relative);
+        const float t = length2 > phi::EPSILON ? glm::clamp(-glm::dot(offset, relative) / length2, 0.0f, 1.0f) : 0.0f;
+
+        if (glm::length(offset + relative * t) <= params.fuse_radius) {
+          return {true, missile.target, start + (missile.position - start) * t};
+        }
+      }
+
+      if (missile.position.y <= get_ground_height(missile.position)) {
+        return {true, -1, glm::vec3(missile.position.x, get_ground_height(missile.position), missile.position.z)};
+      }
+
+      if (missile.age >= params.lifetime) return {true, -1, missile.position};
+    }
+
+    return {false, -1, missile.position};
+  }
+};
+};  // namespace missiles
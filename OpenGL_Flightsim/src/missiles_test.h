@@ -0,0 +1,41 @@
+/*
+    Unit tests for missiles.h, engagements over flat ground without a terrain
+*/
+#pragma once
+
+#include <vector>
+
+#include "missiles.h"
+#include "phi.h"
+#include "unittest.h"
+
+namespace missiles {
+
+inline int run_unit_tests() {
+  const int failures = unittest::failures;
+
+  // a target straight ahead of the shooter is hit, unless it crashes while the missile is on its way. the missile
+  // then flies on unguided and never reports the wreck as hit
+  for (const bool crashes : {false, true}) {
+    phi::RigidBody shooter;
+    shooter.position = glm::vec3(0.0f, 3000.0f, 0.0f), shooter.velocity = glm::vec3(250.0f, 0.0f, 0.0f);
+
+    Track tracks[2] = {{shooter.position, shooter.velocity}, {glm::vec3(1500.0f, 3000.0f, 0.0f), glm::vec3(0.0f)}};
+    MissileSystem missiles;
+
+    const int target = missiles.lock_on(shooter, 0, tracks, 2);
+    CHECK(target == 1 && missiles.launch(shooter, 0, target));
+
+    std::vector<Detonation> detonations;
+    for (int frame = 0; frame < 60 * 30 && detonations.empty(); frame++) {
+      if (crashes && frame == 30) tracks[1].active = false;
+      detonations = missiles.update(1.0f / 60.0f, tracks, 2);
+    }
+
+    CHECK(detonations.size() == 1 && missiles.get_missiles().empty());
+    if (!detonations.empty()) CHECK(detonations[0].owner == 0 && detonations[0].target == (crashes ? -1 : 1));
+  }
+
+  return unittest::report("missiles", failures);
+}
+};  // namespace missiles
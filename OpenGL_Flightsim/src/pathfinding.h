@@ -0,0 +1,292 @@
+/*
+    Terrain aware route planning, Theta* (any-angle A*) over a coarse heightmap grid with altitude layers
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "jobs.h"
+
+namespace pathfinding {
+
+typedef std::function<float(const glm::vec2&)> HeightFunction;
+
+// downsampled terrain, every cell stores the highest point of the terrain it covers
+struct HeightGrid {
+  glm::vec2 origin;
+  float cell_size;
+  int width, height;
+  std::vector<float> max_heights;
+
+  HeightGrid(const HeightFunction& get_height, const glm::vec2& min, const glm::vec2& max, float cell_size,
+             int samples_per_cell = 4)
+      : origin(min),
+        cell_size(cell_size),
+        width(static_cast<int>(std::ceil((max.x - min.x) / cell_size))),
+        height(static_cast<int>(std::ceil((max.y - min.y) / cell_size))) {
+    assert(width > 0 && height > 0 && samples_per_cell > 1);
+    max_heights.resize(width * height);
+
+    const float step = cell_size / static_cast<float>(samples_per_cell - 1);
+
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        float highest = std::numeric_limits<float>::lowest();
+        glm::vec2 corner = origin + glm::vec2(x, y) * cell_size;
+
+        for (int j = 0; j < samples_per_cell; j++) {
+          for (int i = 0; i < samples_per_cell; i++) {
+            highest = std::max(highest, get_height(corner + glm::vec2(i, j) * step));
+          }
+        }
+        max_heights[y * width + x] = highest;
+      }
+    }
+  }
+
+  inline bool contains(const glm::ivec2& cell) const {
+    return cell.x >= 0 && cell.y >= 0 && cell.x < width && cell.y < height;
+  }
+
+  // cell containing a world space position, positions outside of the grid are clamped to the border
+  inline glm::ivec2 get_cell(const glm::vec3& position) const {
+    glm::ivec2 cell(glm::floor((glm::vec2(position.x, position.z) - origin) / cell_size));
+    return glm::clamp(cell, glm::ivec2(0), glm::ivec2(width - 1, height - 1));
+  }
+
+  // world space center of a cell in the xz plane
+  inline glm::vec2 get_center(const glm::ivec2& cell) const {
+    return origin + (glm::vec2(cell) + glm::vec2(0.5f)) * cell_size;
+  }
+
+  inline float get_max_height(const glm::ivec2& cell) const { return max_heights[cell.y * width + cell.x]; }
+};
+
+struct PlannerParams {
+  int layers = 16;              // number of altitude layers
+  float layer_height = 250.0f;  // vertical distance between layers, m
+  float clearance = 150.0f;     // minimum distance to the terrain, m
+  float climb_penalty = 2.0f;   // climbing costs more than flying level
+  int max_expansions = 250000;  // give up after expanding this many nodes
+  size_t max_cached_routes = 1024;
+};
+
+struct Route {
+  bool found = false;
+  std::vector<glm::vec3> waypoints;  // world space, from start to goal
+};
+
+class Planner {
+ public:
+  Planner(std::shared_ptr<const HeightGrid> height_grid, jobs::ThreadPool& thread_pool,
+          const PlannerParams& planner_params = {})
+      : grid(std::move(height_grid)), pool(thread_pool), params(planner_params) {}
+
+  // routes are planned on the thread pool and capture this planner
+  ~Planner() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_in_flight == 0; });
+  }
+
+  Planner(const Planner&) = delete;
+  Planner& operator=(const Planner&) = delete;
+
+  // never blocks, returns the cached route for the start and goal cells or schedules
+  // planning on a worker thread and returns nullptr until the route is ready
+  std::shared_ptr<const Route> get_route(const glm::vec3& start, const glm::vec3& goal) {
+    const int start_node = get_node(start), goal_node = get_node(goal);
+
+    static const auto unreachable = std::make_shared<const Route>();
+    if (start_node < 0 || goal_node < 0) return unreachable;
+
+    const uint64_t key = (static_cast<uint64_t>(start_node) << 32) | static_cast<uint64_t>(goal_node);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (auto it = m_cache.find(key); it != m_cache.end()) return it->second;
+
+    if (m_pending.insert(key).second) {
+      m_in_flight++;
+      pool.submit([this, key, start_node, goal_node]() {
+        auto route = std::make_shared<const Route>(search(start_node, goal_node));
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cache.size() >= params.max_cached_routes) m_cache.clear();
+        m_cache[key] = std::move(route);
+        m_pending.erase(key);
+
+        if (--m_in_flight == 0) m_idle.notify_all();
+      });
+    }
+
+    return nullptr;
+  }
+
+  // plan a route on the calling thread, bypasses the cache
+  Route plan(const glm::vec3& start, const glm::vec3& goal) const {
+    const int start_node = get_node(start), goal_node = get_node(goal);
+    if (start_node < 0 || goal_node < 0) return {};
+    return search(start_node, goal_node);
+  }
+
+  // true if the straight line from a to b keeps the minimum clearance to the terrain
+  bool line_of_sight(const glm::vec3& a, const glm::vec3& b) const {
+    const glm::vec3 delta = b - a;
+    const float distance = glm::length(glm::vec2(delta.x, delta.z));
+    const int steps = std::max(1, static_cast<int>(std::ceil(2.0f * distance / grid->cell_size)));
+
+    for (int i = 0; i <= steps; i++) {
+      auto point = a + delta * (static_cast<float>(i) / static_cast<float>(steps));
+      if (point.y < grid->get_max_height(grid->get_cell(point)) + params.clearance) return false;
+    }
+
+    return true;
+  }
+
+  void clear_cache() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache.clear();
+  }
+
+  const std::shared_ptr<const HeightGrid> grid;
+  jobs::ThreadPool& pool;
+  const PlannerParams params;
+
+ private:
+  std::mutex m_mutex;
+  std::condition_variable m_idle;
+  int m_in_flight = 0;
+  std::unordered_set<uint64_t> m_pending;
+  std::unordered_map<uint64_t, std::shared_ptr<const Route>> m_cache;
+
+  inline int node_count() const { return grid->width * grid->height * params.layers; }
+
+  inline int get_index(const glm::ivec2& cell, int layer) const {
+    return (layer * grid->height + cell.y) * grid->width + cell.x;
+  }
+
+  inline float get_altitude(int layer) const { return static_cast<float>(layer) * params.layer_height; }
+
+  inline glm::vec3 get_position(int node) const {
+    const int layer = node / (grid->width * grid->height);
+    const int cell = node % (grid->width * grid->height);
+    const auto center = grid->get_center({cell % grid->width, cell / grid->width});
+    return {center.x, get_altitude(layer), center.y};
+  }
+
+  inline bool is_free(const glm::ivec2& cell, int layer) const {
+    return get_altitude(layer) >= grid->get_max_height(cell) + params.clearance;
+  }
+
+  // closest free node to a position, searching upwards if the position is too close to the terrain
+  int get_node(const glm::vec3& position) const {
+    const auto cell = grid->get_cell(position);
+    int layer = static_cast<int>(std::round(position.y / params.layer_height));
+
+    for (layer = glm::clamp(layer, 0, params.layers - 1); layer < params.layers; layer++) {
+      if (is_free(cell, layer)) return get_index(cell, layer);
+    }
+
+    return -1;
+  }
+
+  inline float get_cost(const glm::vec3& from, const glm::vec3& to) const {
+    const auto delta = to - from;
+    const float climb = delta.y > 0.0f ? delta.y * params.climb_penalty : -delta.y;
+    return glm::length(glm::vec2(delta.x, delta.z)) + climb;
+  }
+
+  Route search(int start, int goal) const {
+    typedef std::pair<float, int> Entry;  // estimated total cost, node
+
+    // scratch buffers are reused by every search on the same worker thread
+    thread_local std::vector<float> cost;
+    thread_local std::vector<int> parent;
+    thread_local std::vector<bool> closed;
+
+    cost.assign(node_count(), std::numeric_limits<float>::max());
+    parent.assign(node_count(), -1);
+    closed.assign(node_count(), false);
+
+    const glm::vec3 goal_position = get_position(goal);
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    cost[start] = 0.0f, parent[start] = start;
+    open.push({glm::length(goal_position - get_position(start)), start});
+
+    for (int expansions = 0; !open.empty() && expansions < params.max_expansions; expansions++) {
+      const int node = open.top().second;
+      open.pop();
+
+      if (closed[node]) continue;
+      closed[node] = true;
+
+      if (node == goal) return reconstruct(parent, start, goal);
+
+      const int layer = node / (grid->width * grid->height);
+      const int index = node % (grid->width * grid->height);
+      const glm::ivec2 cell(index % grid->width, index / grid->width);
+      const glm::vec3 parent_position = get_position(parent[node]);
+
+      for (int dl = -1; dl <= 1; dl++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            const glm::ivec2 next_cell = cell + glm::ivec2(dx, dy);
+            const int next_layer = layer + dl;
+
+            if ((dx | dy | dl) == 0 || !grid->contains(next_cell)) continue;
+            if (next_layer < 0 || next_layer >= params.layers || !is_free(next_cell, next_layer)) continue;
+
+            const int next = get_index(next_cell, next_layer);
+            if (closed[next]) continue;
+
+            const glm::vec3 next_position = get_position(next);
+
+            // theta*: connect straight to our parent if it can see the neighbour
+            int via = node;
+            float next_cost = cost[node] + get_cost(get_position(node), next_position);
+
+            if (line_of_sight(parent_position, next_position)) {
+              via = parent[node];
+              next_cost = cost[via] + get_cost(parent_position, next_position);
+            }
+
+            if (next_cost < cost[next]) {
+              cost[next] = next_cost, parent[next] = via;
+              open.push({next_cost + glm::length(goal_position - next_position), next});
+            }
+          }
+        }
+      }
+    }
+
+    return {};
+  }
+
+  Route reconstruct(const std::vector<int>& parent, int start, int goal) const {
+    Route route{.found = true};
+
+    for (int node = goal; node != start; node = parent[node]) {
+      route.waypoints.push_back(get_position(node));
+    }
+    route.waypoints.push_back(get_position(start));
+
+    std::reverse(route.waypoints.begin(), route.waypoints.end());
+    return route;
+  }
+};
+};  // namespace pathfinding
@@ -0,0 +1,294 @@
+/*
+    Gun rounds in a fixed pool stored as structure of arrays, integrated in batches and swept against aircraft
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "collisions.h"
+#include "phi.h"
+#include "simd.h"
+#include "spatial.h"
+#include "terrain.h"
+
+namespace projectiles {
+
+struct ProjectileParams {
+  int capacity = 16384;          // rounds in flight, nothing is allocated after construction
+  float drag = 0.0003f;          // a = -drag * |v| * v, 1/m
+  phi::Seconds lifetime = 4.0f;  // rounds are removed after this, s
+  float radius = 0.01f;          // of a round, m
+  float cell_size = 100.0f;      // of the broadphase grid over the targets, m
+  int max_targets = 4;           // tested per round and step, the closest ones if more are in reach
+};
+
+struct Gun {
+  glm::vec3 muzzle{};               // body space, the gun points forward, m
+  float muzzle_velocity = 1000.0f;  // relative to the aircraft, m/s
+  float rate_of_fire = 100.0f;      // rounds/s
+  int ammo = 510;                   // rounds left
+  bool trigger = false;             // fires while held
+  phi::Seconds cooldown = 0.0f;     // until the next round, s
+};
+
+struct Hit {
+  int owner, target;
+  float t;          // fraction of the step at impact
+  glm::vec3 point;  // round position at impact
+};
+
+class ProjectileSystem {
+ public:
+  ProjectileSystem(const ProjectileParams& projectile_params = {}, const terrain::TerrainField* terrain_field = nullptr)
+      : params(projectile_params), terrain(terrain_field), m_grid(projectile_params.cell_size) {
+    // keep whole blocks of 4 in bounds for the simd loops
+    const size_t size = (params.capacity + 3) / 4 * 4;
+    for (auto* array : {&m_x, &m_y, &m_z, &m_vx, &m_vy, &m_vz, &m_dx, &m_dy, &m_dz, &m_age, &m_ground}) {
+      array->resize(size, 0.0f);
+    }
+    m_owner.resize(size, -1);
+
+    m_hits.reserve(params.capacity);
+    m_query.reserve(64);
+    m_removed.reserve(params.capacity);
+    m_candidates.reserve(static_cast<size_t>(params.capacity) * params.max_targets);
+  }
+
+  // add a round, returns false if the pool is full
+  bool spawn(const glm::vec3& position, const glm::vec3& velocity, int owner) {
+    if (m_count >= params.capacity) return false;
+
+    const int i = m_count++;
+    m_x[i] = position.x, m_y[i] = position.y, m_z[i] = position.z;
+    m_vx[i] = velocity.x, m_vy[i] = velocity.y, m_vz[i] = velocity.z;
+    m_dx[i] = m_dy[i] = m_dz[i] = 0.0f;
+    m_age[i] = 0.0f;
+    m_owner[i] = owner;
+    return true;
+  }
+
+  // fire the rounds that are due during a step of dt while the trigger is held, returns the number fired
+  int fire(Gun& gun, const phi::RigidBody& shooter, int owner, phi::Seconds dt) {
+    gun.cooldown -= dt;
+
+    int fired = 0;
+    while (gun.trigger && gun.ammo > 0 && gun.cooldown <= 0.0f) {
+      const auto position = shooter.position + shooter.transform_direction(gun.muzzle);
+      if (!spawn(position, shooter.velocity + shooter.forward() * gun.muzzle_velocity, owner)) break;
+
+      gun.ammo--, fired++;
+      gun.cooldown += 1.0f / gun.rate_of_fire;
+    }
+
+    // the gun doesn't save up rounds while the trigger is released
+    gun.cooldown = std::max(gun.cooldown, 0.0f);
+    return fired;
+  }
+
+  // move every round with gravity and drag and remove rounds that expired or hit the ground
+  void update(phi::Seconds dt) {
+    int i = 0;
+#if SIMD_SSE2
+    const __m128 step = _mm_set1_ps(dt), drag = _mm_set1_ps(params.drag);
+    const __m128 gravity = _mm_set1_ps(phi::EARTH_GRAVITY * dt);
+
+    for (; i + 4 <= m_count; i += 4) {
+      auto vx = _mm_loadu_ps(&m_vx[i]), vy = _mm_loadu_ps(&m_vy[i]), vz = _mm_loadu_ps(&m_vz[i]);
+      auto speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+      auto damping = _mm_mul_ps(_mm_mul_ps(drag, speed), step);
+
+      // semi implicit euler, same order of operations as integrate()
+      vx = _mm_sub_ps(vx, _mm_mul_ps(vx, damping));
+      vy = _mm_sub_ps(_mm_sub_ps(vy, _mm_mul_ps(vy, damping)), gravity);
+      vz = _mm_sub_ps(vz, _mm_mul_ps(vz, damping));
+
+      auto dx = _mm_mul_ps(vx, step), dy = _mm_mul_ps(vy, step), dz = _mm_mul_ps(vz, step);
+
+      _mm_storeu_ps(&m_vx[i], vx), _mm_storeu_ps(&m_vy[i], vy), _mm_storeu_ps(&m_vz[i], vz);
+      _mm_storeu_ps(&m_dx[i], dx), _mm_storeu_ps(&m_dy[i], dy), _mm_storeu_ps(&m_dz[i], dz);
+      _mm_storeu_ps(&m_x[i], _mm_add_ps(_mm_loadu_ps(&m_x[i]), dx));
+      _mm_storeu_ps(&m_y[i], _mm_add_ps(_mm_loadu_ps(&m_y[i]), dy));
+      _mm_storeu_ps(&m_z[i], _mm_add_ps(_mm_loadu_ps(&m_z[i]), dz));
+      _mm_storeu_ps(&m_age[i], _mm_add_ps(_mm_loadu_ps(&m_age[i]), step));
+    }
+#endif
+    for (; i < m_count; i++) integrate(i, dt);
+
+    if (terrain) {
+      terrain->get_heights(m_x.data(), m_z.data(), m_count, m_ground.data());
+    } else {
+      std::fill(m_ground.begin(), m_ground.begin() + m_count, 0.0f);
+    }
+
+    // backwards so every round that is swapped in has already been checked
+    for (i = m_count - 1; i >= 0; i--) {
+      if (m_age[i] > params.lifetime || m_y[i] < m_ground[i]) remove(i);
+    }
+  }
+
+  // sweep the rounds along their last step against targets that moved by displacements during the same step.
+  // a round hits the first target it touches and is removed, rounds never hit their owner (the target index)
+  const std::vector<Hit>& collide(const collisions::Sphere* targets, const glm::vec3* displacements, int count) {
+    m_hits.clear();
+
+    // targets are tracked at the middle of their motion, reach covers their radius and half the motion
+    float reach = 0.0f;
+    for (int i = 0; i < count; i++) {
+      const auto middle = targets[i].center + displacements[i] * 0.5f;
+      m_grid.contains(i) ? m_grid.update(i, middle) : m_grid.insert(i, middle);
+      reach = std::max(reach, targets[i].radius + 0.5f * glm::length(displacements[i]));
+    }
+    for (int i = count; i < m_target_count; i++) m_grid.remove(i);
+    m_target_count = count;
+
+    if (count == 0 || m_count == 0) return m_hits;
+
+    auto& c = m_candidates;
+    c.clear();
+
+    for (int i = 0; i < m_count; i++) {
+      const glm::vec3 displacement(m_dx[i], m_dy[i], m_dz[i]);
+      const glm::vec3 start = glm::vec3(m_x[i], m_y[i], m_z[i]) - displacement;
+
+      const auto middle = start + displacement * 0.5f;
+      m_query.clear();
+      m_grid.query_radius(middle, reach + params.radius + 0.5f * glm::length(displacement), m_query);
+      std::erase(m_query, m_owner[i]);
+
+      // keeps the candidates within the space reserved for them
+      if (static_cast<int>(m_query.size()) > params.max_targets) {
+        auto distance = [&](int target) {
+          const auto offset = targets[target].center + displacements[target] * 0.5f - middle;
+          return glm::dot(offset, offset);
+        };
+        std::partial_sort(m_query.begin(), m_query.begin() + params.max_targets, m_query.end(),
+                          [&](int a, int b) { return distance(a) < distance(b); });
+        m_query.resize(params.max_targets);
+      }
+
+      for (int target : m_query) {
+        c.add(i, start, displacement, params.radius, target, targets[target], displacements[target]);
+      }
+    }
+
+    const int n = c.size();
+    collisions::test_moving_collision(c.spheres0(), c.velocities0(), c.spheres1(), c.velocities1(), n, c.t.data(),
+                                      c.hit.data());
+
+    // candidates of a round are next to each other, keep the earliest hit of each
+    m_removed.clear();
+    for (int begin = 0, end; begin < n; begin = end) {
+      int first = -1;
+      float first_t = 0.0f;
+      for (end = begin; end < n && c.round[end] == c.round[begin]; end++) {
+        if (!c.hit[end]) continue;
+
+        // the narrowphase measures t along the relative motion, turn it into a fraction of the step
+        const glm::vec3 relative(c.dx0[end] - c.dx1[end], c.dy0[end] - c.dy1[end], c.dz0[end] - c.dz1[end]);
+        const float length = glm::length(relative);
+        const float t = length > collisions::EPSILON ? std::min(c.t[end] / length, 1.0f) : 0.0f;
+
+        if (first < 0 || t < first_t) first = end, first_t = t;
+      }
+      if (first < 0) continue;
+
+      const int i = c.round[first];
+      const glm::vec3 start(c.x0[first], c.y0[first], c.z0[first]);
+      const glm::vec3 displacement(c.dx0[first], c.dy0[first], c.dz0[first]);
+      m_hits.push_back({m_owner[i], c.target[first], first_t, start + displacement * first_t});
+      m_removed.push_back(i);
+    }
+
+    // from the back, rounds swapped in from the end of the pool have already been handled
+    for (auto it = m_removed.rbegin(); it != m_removed.rend(); ++it) remove(*it);
+
+    return m_hits;
+  }
+
+  inline int size() const { return m_count; }
+
+  inline glm::vec3 get_position(int i) const { return {m_x[i], m_y[i], m_z[i]}; }
+  inline glm::vec3 get_velocity(int i) const { return {m_vx[i], m_vy[i], m_vz[i]}; }
+  inline int get_owner(int i) const { return m_owner[i]; }
+
+  const ProjectileParams params;
+  const terrain::TerrainField* terrain;  // rounds below it are removed, flat ground at y = 0 without one
+
+ private:
+  // candidate pairs in the layout the batch narrowphase expects, 0 is the round and 1 the target
+  struct Candidates {
+    std::vector<int> round, target;
+    std::vector<float> x0, y0, z0, dx0, dy0, dz0, r0, x1, y1, z1, dx1, dy1, dz1, r1, t;
+    std::vector<uint8_t> hit;
+
+    void reserve(size_t n) {
+      round.reserve(n), target.reserve(n), hit.reserve(n);
+      for_each_float([n](std::vector<float>& array) { array.reserve(n); });
+    }
+
+    void clear() {
+      round.clear(), target.clear(), hit.clear();
+      for_each_float([](std::vector<float>& array) { array.clear(); });
+    }
+
+    template <typename Func>
+    void for_each_float(Func&& func) {
+      for (auto* array : {&x0, &y0, &z0, &dx0, &dy0, &dz0, &r0, &x1, &y1, &z1, &dx1, &dy1, &dz1, &r1, &t}) func(*array);
+    }
+
+    void add(int i, const glm::vec3& start, const glm::vec3& displacement, float radius, int j,
+             const collisions::Sphere& sphere, const glm::vec3& velocity) {
+      round.push_back(i), target.push_back(j), hit.push_back(0), t.push_back(0.0f);
+      x0.push_back(start.x), y0.push_back(start.y), z0.push_back(start.z), r0.push_back(radius);
+      dx0.push_back(displacement.x), dy0.push_back(displacement.y), dz0.push_back(displacement.z);
+      x1.push_back(sphere.center.x), y1.push_back(sphere.center.y), z1.push_back(sphere.center.z);
+      r1.push_back(sphere.radius);
+      dx1.push_back(velocity.x), dy1.push_back(velocity.y), dz1.push_back(velocity.z);
+    }
+
+    int size() const { return static_cast<int>(round.size()); }
+
+    collisions::SphereBatch spheres0() const { return {{x0.data(), y0.data(), z0.data()}, r0.data()}; }
+    collisions::SphereBatch spheres1() const { return {{x1.data(), y1.data(), z1.data()}, r1.data()}; }
+    collisions::Vec3Batch velocities0() const { return {dx0.data(), dy0.data(), dz0.data()}; }
+    collisions::Vec3Batch velocities1() const { return {dx1.data(), dy1.data(), dz1.data()}; }
+  };
+
+  int m_count = 0, m_target_count = 0;
+  std::vector<float> m_x, m_y, m_z, m_vx, m_vy, m_vz, m_dx, m_dy, m_dz, m_age, m_ground;
+  std::vector<int> m_owner;
+
+  spatial::HashGrid m_grid;
+  std::vector<int> m_query, m_removed;
+  Candidates m_candidates;
+  std::vector<Hit> m_hits;
+
+  // scalar version of the simd loop in update()
+  inline void integrate(int i, phi::Seconds dt) {
+    const float speed = std::sqrt(m_vx[i] * m_vx[i] + m_vy[i] * m_vy[i] + m_vz[i] * m_vz[i]);
+    const float damping = params.drag * speed * dt;
+
+    m_vx[i] = m_vx[i] - m_vx[i] * damping;
+    m_vy[i] = (m_vy[i] - m_vy[i] * damping) - phi::EARTH_GRAVITY * dt;
+    m_vz[i] = m_vz[i] - m_vz[i] * damping;
+
+    m_dx[i] = m_vx[i] * dt, m_dy[i] = m_vy[i] * dt, m_dz[i] = m_vz[i] * dt;
+    m_x[i] += m_dx[i], m_y[i] += m_dy[i], m_z[i] += m_dz[i];
+    m_age[i] += dt;
+  }
+
+  // swap with the last round, the pool stays dense for the simd loops
+  void remove(int i) {
+    const int last = --m_count;
+    m_x[i] = m_x[last], m_y[i] = m_y[last], m_z[i] = m_z[last];
+    m_vx[i] = m_vx[last], m_vy[i] = m_vy[last], m_vz[i] = m_vz[last];
+    m_dx[i] = m_dx[last], m_dy[i] = m_dy[last], m_dz[i] = m_dz[last];
+    m_age[i] = m_age[last], m_ground[i] = m_ground[last];
+    m_owner[i] = m_owner[last];
+  }
+};
+};  // namespace projectiles
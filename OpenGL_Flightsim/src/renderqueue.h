@@ -0,0 +1,149 @@
+/*
+    Flat list of draw items sorted by 64 bit keys, items that share a shader, material or geometry end up next to each
+    other so their state is bound once. Nothing here calls gl, the queue works without a context
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#define RUN_RENDER_QUEUE_UNITTESTS 0
+
+namespace gfx {
+
+class Object3D;
+
+enum class RenderPass : uint8_t {
+  BACKGROUND = 0,   // drawn first, e.g. the skybox
+  OPAQUE = 1,       // front to back
+  TRANSPARENT = 2,  // back to front, after everything else
+};
+
+// ids of the state an item needs. items with shader 0 bind their own state, the state after them is unknown
+struct DrawState {
+  uint32_t shader = 0;
+  uint32_t material = 0;
+  uint32_t geometry = 0;
+};
+
+// state that differs from what the previous item left bound
+struct StateChanges {
+  bool shader = true;
+  bool material = true;
+  bool geometry = true;
+};
+
+// consecutive items with the same state, drawn with one instanced call. items that bind their own state are alone
+struct DrawBatch {
+  int first = 0;  // index of the first item after sorting, which is also its instance
+  int count = 1;
+  StateChanges changes;
+};
+
+struct DrawItem {
+  uint64_t key;
+  uint32_t sequence;  // order of submission, breaks ties so equal keys draw in scene graph order
+  Object3D* object;
+  DrawState state;
+};
+
+namespace render_key {
+
+constexpr int PASS_BITS = 4, SHADER_BITS = 12, MATERIAL_BITS = 16, GEOMETRY_BITS = 16, DEPTH_BITS = 16;
+
+constexpr uint64_t mask(int bits) { return (uint64_t(1) << bits) - 1; }
+
+// the upper bits of a non negative float sort the same way as the float
+inline uint64_t quantize_depth(float depth) {
+  depth = std::max(depth, 0.0f);
+  uint32_t bits;
+  std::memcpy(&bits, &depth, sizeof(bits));
+  return bits >> (32 - DEPTH_BITS);
+}
+
+// pass | shader | material | geometry | depth. transparent items are sorted far to near before their state, ids that
+// don't fit their field wrap around which only costs a few extra binds
+inline uint64_t make(RenderPass pass, const DrawState& state, float depth) {
+  const uint64_t shader = state.shader & mask(SHADER_BITS);
+  const uint64_t material = state.material & mask(MATERIAL_BITS);
+  const uint64_t geometry = state.geometry & mask(GEOMETRY_BITS);
+  const uint64_t distance = quantize_depth(depth);
+
+  uint64_t key = static_cast<uint64_t>(pass) & mask(PASS_BITS);
+
+  if (pass == RenderPass::TRANSPARENT) {
+    key = (key << DEPTH_BITS) | (mask(DEPTH_BITS) - distance);
+    key = (key << SHADER_BITS) | shader;
+    key = (key << MATERIAL_BITS) | material;
+    key = (key << GEOMETRY_BITS) | geometry;
+  } else {
+    key = (key << SHADER_BITS) | shader;
+    key = (key << MATERIAL_BITS) | material;
+    key = (key << GEOMETRY_BITS) | geometry;
+    key = (key << DEPTH_BITS) | distance;
+  }
+  return key;
+}
+
+inline RenderPass get_pass(uint64_t key) {
+  return static_cast<RenderPass>(key >> (64 - PASS_BITS));
+}
+};  // namespace render_key
+
+class RenderQueue {
+ public:
+  inline void clear() { m_items.clear(); }
+
+  // depth is the distance to the camera
+  inline void push(Object3D* object, RenderPass pass, const DrawState& state, float depth) {
+    m_items.push_back({render_key::make(pass, state, depth), static_cast<uint32_t>(m_items.size()), object, state});
+  }
+
+  inline void sort() {
+    std::sort(m_items.begin(), m_items.end(), [](const DrawItem& a, const DrawItem& b) {
+      return a.key != b.key ? a.key < b.key : a.sequence < b.sequence;
+    });
+  }
+
+  // calls draw(batch) in sorted order. batches and changes are found by comparing the full ids, not the key bits
+  template <typename Function>
+  void submit(Function&& draw) const {
+    DrawState bound;
+    bool known = false;
+    const int count = static_cast<int>(m_items.size());
+
+    for (int first = 0; first < count;) {
+      const auto& state = m_items[first].state;
+
+      int last = first + 1;
+      if (state.shader != 0) {
+        while (last < count && same_state(m_items[last].state, state)) last++;
+      }
+
+      DrawBatch batch{first, last - first};
+      if (known) {
+        batch.changes.shader = state.shader != bound.shader;
+        batch.changes.material = batch.changes.shader || state.material != bound.material;
+        batch.changes.geometry = state.geometry != bound.geometry;
+      }
+
+      draw(batch);
+
+      bound = state;
+      known = state.shader != 0;
+      first = last;
+    }
+  }
+
+  inline const std::vector<DrawItem>& get_items() const { return m_items; }
+
+ private:
+  std::vector<DrawItem> m_items;
+
+  static inline bool same_state(const DrawState& a, const DrawState& b) {
+    return a.shader == b.shader && a.material == b.material && a.geometry == b.geometry;
+  }
+};
+};  // namespace gfx
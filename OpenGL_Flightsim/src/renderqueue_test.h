@@ -0,0 +1,105 @@
+/*
+    Unit tests for renderqueue.h, they run without a gl context
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "renderqueue.h"
+#include "unittest.h"
+
+namespace gfx {
+
+inline bool operator==(const StateChanges& a, const StateChanges& b) {
+  return a.shader == b.shader && a.material == b.material && a.geometry == b.geometry;
+}
+
+inline int run_render_queue_tests() {
+  const int failures = unittest::failures;
+
+  // keys order by pass, then by state with opaque items front to back and transparent items back to front
+  {
+    std::mt19937 rng(3);
+    RenderQueue queue;
+    std::vector<float> depths;
+
+    for (int i = 0; i < 1000; i++) {
+      const DrawState state{static_cast<uint32_t>(rng() % 4), static_cast<uint32_t>(rng() % 4),
+                            static_cast<uint32_t>(rng() % 4)};
+      const auto pass = static_cast<RenderPass>(rng() % 3);
+      depths.push_back(static_cast<float>(rng() % 2000) * 0.25f);
+      queue.push(nullptr, pass, state, depths.back());
+    }
+    queue.sort();
+
+    const auto& items = queue.get_items();
+    for (size_t i = 1; i < items.size(); i++) {
+      const auto &a = items[i - 1], &b = items[i];
+      const auto pass = render_key::get_pass(b.key);
+      // depths are compared as precisely as the keys keep them
+      const auto depth_a = render_key::quantize_depth(depths[a.sequence]);
+      const auto depth_b = render_key::quantize_depth(depths[b.sequence]);
+
+      CHECK(render_key::get_pass(a.key) <= pass);
+      if (render_key::get_pass(a.key) != pass) continue;
+
+      if (pass == RenderPass::TRANSPARENT) {
+        CHECK(depth_a >= depth_b);
+        continue;
+      }
+
+      const auto &s = a.state, &t = b.state;
+      CHECK(s.shader <= t.shader);
+      if (s.shader == t.shader) CHECK(s.material <= t.material);
+      if (s.shader == t.shader && s.material == t.material) CHECK(s.geometry <= t.geometry);
+      if (s.shader == t.shader && s.material == t.material && s.geometry == t.geometry) {
+        CHECK(depth_a <= depth_b);
+        if (depth_a == depth_b) CHECK(a.sequence < b.sequence);
+      }
+    }
+  }
+
+  // batches and state changes. items with shader 0 bind their own state, so nothing is known after them
+  {
+    RenderQueue queue;
+    queue.push(nullptr, RenderPass::BACKGROUND, {3, 1, 1}, 0.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {1, 2, 2}, 1.0f);  // sorts behind the next four
+    queue.push(nullptr, RenderPass::OPAQUE, {0, 1, 1}, 1.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {0, 1, 1}, 1.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {1, 1, 1}, 2.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {1, 1, 1}, 1.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {1, 1, 2}, 1.0f);
+    queue.push(nullptr, RenderPass::OPAQUE, {2, 2, 2}, 1.0f);
+    queue.sort();
+
+    const std::vector<DrawBatch> expected = {
+        {0, 1, {true, true, true}},    // background
+        {1, 1, {true, true, false}},   // shader 0, the background left its geometry bound
+        {2, 1, {true, true, true}},    // shader 0 again, not merged and not known
+        {3, 2, {true, true, true}},    // after shader 0, even though the geometry is the same
+        {5, 1, {false, false, true}},  // new geometry
+        {6, 1, {false, true, false}},  // new material, same geometry
+        {7, 1, {true, true, false}},   // a new shader always binds the material again
+    };
+
+    std::vector<DrawBatch> batches;
+    queue.submit([&](const DrawBatch& batch) { batches.push_back(batch); });
+
+    CHECK(batches.size() == expected.size());
+    for (size_t i = 0; i < std::min(batches.size(), expected.size()); i++) {
+      CHECK(batches[i].first == expected[i].first);
+      CHECK(batches[i].count == expected[i].count);
+      CHECK(batches[i].changes == expected[i].changes);
+    }
+
+    // the two {1, 1, 1} items keep front to back order inside their batch
+    const auto& items = queue.get_items();
+    CHECK(items[3].sequence == 5 && items[4].sequence == 4);
+  }
+
+  return unittest::report("render queue", failures);
+}
+};  // namespace gfx
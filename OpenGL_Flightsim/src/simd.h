@@ -0,0 +1,28 @@
+/*
+    SSE2 helpers for the batch queries, every batch function keeps a scalar path for other targets
+*/
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE2 0
+#endif
+
+#if SIMD_SSE2
+namespace simd {
+
+// mask ? a : b for every lane
+inline __m128 select(__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+// same as std::floor for |x| < 2^31, SSE2 has no rounding instruction
+inline __m128 floor(__m128 x) {
+  auto truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+// a + (b - a) * t, the scalar code uses the same order of operations
+inline __m128 lerp(__m128 a, __m128 b, __m128 t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)); }
+};  // namespace simd
+#endif
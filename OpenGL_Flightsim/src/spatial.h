@@ -0,0 +1,184 @@
+/*
+    Uniform spatial hash grid for neighbour queries between many objects
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <vector>
+
+#include "phi.h"
+
+namespace spatial {
+
+// infinite uniform grid of cubic cells hashed into a fixed number of buckets, objects are referred to by
+// small integer ids. moving an object only touches the buckets when it crosses into another cell.
+class HashGrid {
+ public:
+  HashGrid(float cell_size, int bucket_count = 4096)
+      : m_cell_size(cell_size), m_inverse_cell_size(1.0f / cell_size), m_buckets(next_power_of_two(bucket_count)) {
+    assert(cell_size > 0.0f);
+  }
+
+  void insert(int id, const glm::vec3& position) {
+    assert(id >= 0);
+    if (id >= static_cast<int>(m_entries.size())) m_entries.resize(id + 1);
+
+    auto& entry = m_entries[id];
+    assert(!entry.active);
+
+    entry.active = true;
+    entry.position = position;
+    entry.cell = get_cell(position);
+    add_to_bucket(id);
+    m_count++;
+  }
+
+  void remove(int id) {
+    auto& entry = m_entries[id];
+    assert(entry.active);
+
+    remove_from_bucket(id);
+    entry.active = false;
+    m_count--;
+  }
+
+  // objects usually stay in their cell between steps, which makes this O(1) without touching any bucket
+  void update(int id, const glm::vec3& position) {
+    auto& entry = m_entries[id];
+    assert(entry.active);
+
+    entry.position = position;
+    auto cell = get_cell(position);
+
+    if (cell != entry.cell) {
+      remove_from_bucket(id);
+      entry.cell = cell;
+      add_to_bucket(id);
+    }
+  }
+
+  inline void update(int id, const phi::RigidBody& rigid_body) { update(id, rigid_body.position); }
+
+  // append the ids of all objects within radius of center to result, in no particular order
+  void query_radius(const glm::vec3& center, float radius, std::vector<int>& result) const {
+    const float radius_squared = radius * radius;
+    const auto min = get_cell(center - glm::vec3(radius));
+    const auto max = get_cell(center + glm::vec3(radius));
+    const auto extent = glm::vec3(max - min) + glm::vec3(1.0f);
+
+    // large queries visit every bucket once instead of every cell
+    if (extent.x * extent.y * extent.z > static_cast<float>(m_buckets.size())) {
+      for (const auto& bucket : m_buckets) {
+        for (int id : bucket) {
+          if (glm::dot(m_entries[id].position - center, m_entries[id].position - center) <= radius_squared) {
+            result.push_back(id);
+          }
+        }
+      }
+      return;
+    }
+
+    for (int z = min.z; z <= max.z; z++) {
+      for (int y = min.y; y <= max.y; y++) {
+        for (int x = min.x; x <= max.x; x++) {
+          const glm::ivec3 cell(x, y, z);
+
+          for (int id : m_buckets[get_bucket(cell)]) {
+            const auto& entry = m_entries[id];
+
+            // different cells can share a bucket, only report objects from the cell we are looking at
+            if (entry.cell != cell) continue;
+            if (glm::dot(entry.position - center, entry.position - center) <= radius_squared) result.push_back(id);
+          }
+        }
+      }
+    }
+  }
+
+  // append the ids of the k objects closest to center to result, sorted by distance. the search radius grows
+  // from one cell until enough objects are found or max_radius is reached
+  void query_nearest(const glm::vec3& center, int k, std::vector<int>& result,
+                     float max_radius = std::numeric_limits<float>::max()) const {
+    const size_t offset = result.size();
+    float radius = std::min(m_cell_size, max_radius);
+
+    for (;;) {
+      result.resize(offset);
+      query_radius(center, radius, result);
+
+      if (static_cast<int>(result.size() - offset) >= std::min(k, m_count) || radius >= max_radius) break;
+
+      radius = std::min(radius * 2.0f, max_radius);
+    }
+
+    auto closer = [this, &center](int a, int b) {
+      const auto da = m_entries[a].position - center, db = m_entries[b].position - center;
+      return glm::dot(da, da) < glm::dot(db, db);
+    };
+
+    const auto end = result.begin() + std::min(result.size(), offset + k);
+    std::partial_sort(result.begin() + offset, end, result.end(), closer);
+    result.erase(end, result.end());
+  }
+
+  inline const glm::vec3& get_position(int id) const { return m_entries[id].position; }
+
+  inline bool contains(int id) const {
+    return id >= 0 && id < static_cast<int>(m_entries.size()) && m_entries[id].active;
+  }
+
+  inline int size() const { return m_count; }
+
+  inline float get_cell_size() const { return m_cell_size; }
+
+ private:
+  struct Entry {
+    glm::vec3 position{};
+    glm::ivec3 cell{};
+    int slot = -1;  // index inside the bucket
+    bool active = false;
+  };
+
+  float m_cell_size, m_inverse_cell_size;
+  int m_count = 0;
+  std::vector<Entry> m_entries;
+  std::vector<std::vector<int>> m_buckets;
+
+  static int next_power_of_two(int value) {
+    int result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+  inline glm::ivec3 get_cell(const glm::vec3& position) const {
+    return glm::ivec3(glm::floor(position * m_inverse_cell_size));
+  }
+
+  inline size_t get_bucket(const glm::ivec3& cell) const {
+    const uint32_t hash = static_cast<uint32_t>(cell.x) * 73856093U ^ static_cast<uint32_t>(cell.y) * 19349663U ^
+                          static_cast<uint32_t>(cell.z) * 83492791U;
+    return hash & (m_buckets.size() - 1);
+  }
+
+  void add_to_bucket(int id) {
+    auto& bucket = m_buckets[get_bucket(m_entries[id].cell)];
+    m_entries[id].slot = static_cast<int>(bucket.size());
+    bucket.push_back(id);
+  }
+
+  // swap with the last id in the bucket so removal is O(1)
+  void remove_from_bucket(int id) {
+    auto& bucket = m_buckets[get_bucket(m_entries[id].cell)];
+    const int slot = m_entries[id].slot;
+
+    bucket[slot] = bucket.back();
+    m_entries[bucket[slot]].slot = slot;
+    bucket.pop_back();
+  }
+};
+};  // namespace spatial
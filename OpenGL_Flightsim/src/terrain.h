@@ -0,0 +1,645 @@
+/*
+    CPU queries of the terrain heightmap, height and normal queries match clipmap.vert
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "collisions.h"
+#include "jobs.h"
+#include "simd.h"
+#include "terraintiles.h"
+
+#define RUN_TERRAIN_UNITTESTS 0
+
+namespace terrain {
+
+// keep in sync with clipmap.vert
+struct TerrainParams {
+  float height_scale = 3000.0f;   // height of a white heightmap texel, m
+  float extent = 25000.0f;        // the heightmap covers [-extent, extent] on x and z, m
+  bool quantize_heights = false;  // cpu only, keeps the heights as QuantizedHeights
+};
+
+struct Contact {
+  float t;           // fraction of the step at the first touch, 0 if the sphere started inside the terrain
+  glm::vec3 point;   // on the surface
+  glm::vec3 normal;  // of the surface
+};
+
+// 16 bit heights in runs of RUN consecutive texels, each run stores its lowest height and a step and every texel an
+// 8 bit multiple of the step. runs that span at most 255 are exact, others are off by at most half a step
+class QuantizedHeights {
+ public:
+  static constexpr size_t RUN = 64;
+
+  QuantizedHeights() = default;
+
+  QuantizedHeights(const uint16_t* texels, size_t count) : m_runs((count + RUN - 1) / RUN), m_deltas(count) {
+    for (size_t r = 0; r < m_runs.size(); r++) {
+      const size_t begin = r * RUN, end = std::min(begin + RUN, count);
+      const auto [lo, hi] = std::minmax_element(texels + begin, texels + end);
+
+      auto& run = m_runs[r];
+      run.base = *lo, run.step = static_cast<uint16_t>(std::max(1, (*hi - *lo + 254) / 255));
+      for (size_t i = begin; i < end; i++) {
+        m_deltas[i] = static_cast<uint8_t>((texels[i] - run.base + run.step / 2) / run.step);
+      }
+    }
+  }
+
+  inline bool empty() const { return m_deltas.empty(); }
+  inline size_t get_bytes() const { return m_runs.size() * sizeof(Run) + m_deltas.size(); }
+
+  inline int operator[](size_t offset) const {
+    const auto& run = m_runs[offset / RUN];
+    return run.base + run.step * m_deltas[offset];
+  }
+
+ private:
+  struct Run {
+    uint16_t base, step;
+  };
+
+  std::vector<Run> m_runs;
+  std::vector<uint8_t> m_deltas;
+};
+
+// samples the maps like the clipmap shader: GL_LINEAR filtering of the base level with GL_REPEAT wrapping.
+// heights are 0 outside of the heightmap, fields that failed to load are flat. ray casts walk a min/max
+// pyramid of the heightmap and only look at texels in blocks the ray comes close to.
+class TerrainField {
+ public:
+  TerrainField(const std::string& heightmap_path, const std::string& normalmap_path, const TerrainParams& params = {})
+      : TerrainField(Image(heightmap_path, 1, 2, DEFAULT_TILE_SIZE, DEFAULT_TEXELS[HEIGHT]),
+                     Image(normalmap_path, 3, 1, DEFAULT_TILE_SIZE, DEFAULT_TEXELS[NORMAL]), params) {}
+
+  // level 0 of the tiles without a copy, the field keeps them alive
+  TerrainField(std::shared_ptr<const TileSource> tiles, const TerrainParams& params = {})
+      : TerrainField(tiles->get_image(HEIGHT, 0).view(), tiles->get_image(NORMAL, 0).view(), params) {
+    m_tiles = std::move(tiles);
+  }
+
+  TerrainField(Image heightmap, Image normalmap, const TerrainParams& terrain_params = {})
+      : params(terrain_params), m_heightmap(std::move(heightmap)), m_normalmap(std::move(normalmap)) {
+    assert(m_heightmap.empty() || (m_heightmap.channels == 1 && m_heightmap.bytes == 2));
+    assert(m_normalmap.empty() || (m_normalmap.channels == 3 && m_normalmap.bytes == 1));
+
+    // views of tiles cost no memory of their own, only texels the field owns are replaced
+    if (params.quantize_heights && !m_heightmap.empty() && !m_heightmap.is_view()) {
+      const auto& h = m_heightmap;
+      m_quantized = QuantizedHeights(h.get_texels<uint16_t>(), h.get_bytes() / 2);
+      m_heightmap = Image(h.width, h.height, h.channels, h.bytes, h.tile_size);
+    }
+    build_pyramid();
+  }
+
+  // texture coordinates of a point on the xz plane, same as getUV
+  inline glm::vec2 get_uv(const glm::vec2& coords) const { return (coords / params.extent + 1.0f) * 0.5f; }
+
+  float get_height(const glm::vec2& coords) const {
+    const auto uv = get_uv(coords);
+    if (m_heightmap.empty() || !inside(uv)) return 0.0f;
+
+    const auto footprint = get_footprint(m_heightmap, uv);
+    return bilinear(footprint, [this](size_t offset) { return get_height_texel(offset); }) *
+           (params.height_scale / 65535.0f);
+  }
+
+  glm::vec3 get_normal(const glm::vec2& coords) const {
+    if (m_normalmap.empty()) return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    const auto footprint = get_footprint(m_normalmap, get_uv(coords));
+    const uint8_t* texels = m_normalmap.get_texels<uint8_t>();
+    glm::vec3 normal;
+    for (int c = 0; c < 3; c++) normal[c] = bilinear(footprint, [=](size_t offset) { return texels[offset + c]; });
+    return glm::normalize(normal);
+  }
+
+  // normal of the height field itself from central differences over one texel, get_normal returns the normal
+  // map the shader lights the terrain with
+  glm::vec3 get_surface_normal(const glm::vec2& coords) const {
+    if (m_heightmap.empty()) return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    const float dx = params.extent / m_heightmap.width, dz = params.extent / m_heightmap.height;
+    const float sx = get_height(coords - glm::vec2(dx, 0.0f)) - get_height(coords + glm::vec2(dx, 0.0f));
+    const float sz = get_height(coords - glm::vec2(0.0f, dz)) - get_height(coords + glm::vec2(0.0f, dz));
+    return glm::normalize(glm::vec3(sx / (2.0f * dx), 1.0f, sz / (2.0f * dz)));
+  }
+
+  // upper bound of the height over a rectangle of the xz plane, looks at no more than 2x2 blocks of the pyramid
+  inline float get_max_height(const glm::vec2& min, const glm::vec2& max) const {
+    return get_height_range(min, max).y;
+  }
+
+  // lower (x) and upper (y) bound of the height over a rectangle of the xz plane, from the same blocks
+  glm::vec2 get_height_range(const glm::vec2& min, const glm::vec2& max) const {
+    if (m_pyramid.empty()) return glm::vec2(0.0f);
+
+    const glm::vec2 size(static_cast<float>(m_heightmap.width), static_cast<float>(m_heightmap.height));
+    const auto lo = glm::clamp(get_uv(min) * size, glm::vec2(0.0f), size);
+    const auto hi = glm::clamp(get_uv(max) * size, glm::vec2(0.0f), size);
+
+    // entirely outside of the map, the ground is flat there
+    if (lo.x == hi.x && (lo.x == 0.0f || lo.x == size.x)) return glm::vec2(0.0f);
+    if (lo.y == hi.y && (lo.y == 0.0f || lo.y == size.y)) return glm::vec2(0.0f);
+
+    // blocks at least as large as the rectangle, it overlaps at most two of them on each axis
+    const float extent = glm::max(hi.x - lo.x, hi.y - lo.y);
+    int level = 0;
+    while (level + 1 < static_cast<int>(m_pyramid.size()) && static_cast<float>(1 << level) < extent) level++;
+
+    const auto& bounds = m_pyramid[level];
+    const float block_size = static_cast<float>(1 << level);
+    const int x0 = std::min(static_cast<int>(lo.x / block_size), bounds.width - 1);
+    const int x1 = std::min(static_cast<int>(hi.x / block_size), bounds.width - 1);
+    const int y0 = std::min(static_cast<int>(lo.y / block_size), bounds.height - 1);
+    const int y1 = std::min(static_cast<int>(hi.y / block_size), bounds.height - 1);
+
+    // parts of the rectangle outside of the map are at 0
+    const bool clipped = !inside(get_uv(min)) || !inside(get_uv(max));
+    glm::vec2 result(clipped ? 0.0f : std::numeric_limits<float>::max(), 0.0f);
+
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        const size_t block = static_cast<size_t>(y) * bounds.width + x;
+        result.x = std::min(result.x, bounds.min[block]), result.y = std::max(result.y, bounds.max[block]);
+      }
+    }
+    return result;
+  }
+
+  inline float get_height(const glm::vec3& position) const { return get_height(glm::vec2(position.x, position.z)); }
+  inline glm::vec3 get_normal(const glm::vec3& position) const {
+    return get_normal(glm::vec2(position.x, position.z));
+  }
+
+  // heights[i] = get_height({x[i], z[i]})
+  void get_heights(const float* x, const float* z, int count, float* heights) const {
+    int i = 0;
+#if SIMD_SSE2
+    if (!m_heightmap.empty()) {
+      const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+      for (; i + 4 <= count; i += 4) {
+        __m128 u, v, height;
+        get_uv4(x + i, z + i, &u, &v);
+
+        auto inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)),
+                                 _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(v, one)));
+
+        // keep the texel lookups of outside lanes in bounds
+        sample4(m_heightmap, simd::select(inside, u, zero), simd::select(inside, v, zero),
+                [this](size_t offset) { return get_height_texel(offset); }, &height);
+        height = _mm_mul_ps(height, _mm_set1_ps(params.height_scale / 65535.0f));
+        _mm_storeu_ps(heights + i, _mm_and_ps(inside, height));
+      }
+    }
+#endif
+    for (; i < count; i++) heights[i] = get_height(glm::vec2(x[i], z[i]));
+  }
+
+  // (nx[i], ny[i], nz[i]) = get_normal({x[i], z[i]})
+  void get_normals(const float* x, const float* z, int count, float* nx, float* ny, float* nz) const {
+    int i = 0;
+#if SIMD_SSE2
+    if (!m_normalmap.empty()) {
+      for (; i + 4 <= count; i += 4) {
+        __m128 u, v, normal[3];
+        get_uv4(x + i, z + i, &u, &v);
+        const uint8_t* texels = m_normalmap.get_texels<uint8_t>();
+        sample4(m_normalmap, u, v, [=](size_t offset) { return texels[offset]; }, normal);
+
+        // same as glm::normalize, v * (1 / sqrt(dot(v, v)))
+        auto length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[0], normal[0]), _mm_mul_ps(normal[1], normal[1])),
+                                         _mm_mul_ps(normal[2], normal[2]));
+        auto inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+
+        _mm_storeu_ps(nx + i, _mm_mul_ps(normal[0], inverse_length));
+        _mm_storeu_ps(ny + i, _mm_mul_ps(normal[1], inverse_length));
+        _mm_storeu_ps(nz + i, _mm_mul_ps(normal[2], inverse_length));
+      }
+    }
+#endif
+    for (; i < count; i++) {
+      const auto normal = get_normal(glm::vec2(x[i], z[i]));
+      nx[i] = normal.x, ny[i] = normal.y, nz[i] = normal.z;
+    }
+  }
+
+  // distance to the first point of the terrain along the ray within max_distance, rays that start below the
+  // terrain hit at 0
+  bool raycast(const collisions::Ray& ray, float max_distance, float* t) const {
+    const float infinity = std::numeric_limits<float>::max();
+
+    // plane at y = 0 outside of the heightmap
+    auto ground = [&ray, infinity](float begin, float end) {
+      if (ray.origin.y + ray.direction.y * begin <= 0.0f) return begin;
+      if (ray.direction.y >= 0.0f) return infinity;
+      float distance = -ray.origin.y / ray.direction.y;
+      return distance <= end ? distance : infinity;
+    };
+
+    float enter, exit;
+    if (m_pyramid.empty() || !clip_to_map(ray, max_distance, &enter, &exit)) {
+      *t = ground(0.0f, max_distance);
+      return *t != infinity;
+    }
+
+    if ((*t = ground(0.0f, enter)) != infinity && *t < enter) return true;
+    if (traverse(ray, enter, exit, t)) return true;
+    if ((*t = ground(exit, max_distance)) != infinity && *t > exit) return true;
+
+    *t = infinity;
+    return false;
+  }
+
+  // t[i] is the distance to the first hit of ray i or std::numeric_limits<float>::max() for a miss, rays
+  // are split over the pool if there is one. returns the number of hits
+  int raycast(const collisions::RayBatch& rays, float max_distance, int count, float* t, uint8_t* hits,
+              jobs::ThreadPool* pool = nullptr) const {
+    auto cast = [&](int i) { hits[i] = raycast(collisions::batch::load(rays, i), max_distance, &t[i]); };
+
+    if (pool) {
+      pool->parallel_for(count, cast, 64);
+    } else {
+      for (int i = 0; i < count; i++) cast(i);
+    }
+
+    int total = 0;
+    for (int i = 0; i < count; i++) total += hits[i];
+    return total;
+  }
+
+  // sphere moving by displacement during a step. the point of the sphere closest to the terrain is swept
+  // along the displacement, which is exact for planar ground and close enough for spheres small compared to
+  // the texels. spheres far above the terrain are rejected with a single bounds lookup
+  bool sweep(const collisions::Sphere& sphere, const glm::vec3& displacement, Contact* contact) const {
+    const auto start = sphere.center, end = sphere.center + displacement;
+    const auto margin = glm::vec2(sphere.radius);
+    const float max_height = get_max_height(glm::vec2(glm::min(start.x, end.x), glm::min(start.z, end.z)) - margin,
+                                            glm::vec2(glm::max(start.x, end.x), glm::max(start.z, end.z)) + margin);
+
+    if (std::min(start.y, end.y) - sphere.radius > max_height) return false;
+
+    const auto normal = get_surface_normal(glm::vec2(start.x, start.z));
+    const auto lowest = start - normal * sphere.radius;
+
+    // the center may already be below the surface if the last step tunneled into the terrain
+    if (start.y <= get_height(start) || lowest.y <= get_height(lowest)) {
+      contact->t = 0.0f;
+      contact->point = glm::vec3(lowest.x, get_height(lowest), lowest.z);
+      contact->normal = get_surface_normal(glm::vec2(lowest.x, lowest.z));
+      return true;
+    }
+
+    const float distance = glm::length(displacement);
+    if (distance < collisions::EPSILON) return false;
+
+    collisions::Ray ray;
+    ray.origin = lowest, ray.direction = displacement / distance;
+
+    float t;
+    if (!raycast(ray, distance, &t)) return false;
+
+    contact->t = t / distance;
+    contact->point = ray.origin + ray.direction * t;
+    contact->normal = get_surface_normal(glm::vec2(contact->point.x, contact->point.z));
+    return true;
+  }
+
+  // sweep every sphere, optionally split over the pool. on_collision of the spheres that hit is called afterwards
+  // on the calling thread in index order. returns the number of hits
+  int sweep(const collisions::Sphere* spheres, const glm::vec3* displacements, int count, Contact* contacts,
+            uint8_t* hits, jobs::ThreadPool* pool = nullptr) const {
+    auto test = [&](int i) { hits[i] = sweep(spheres[i], displacements[i], &contacts[i]); };
+
+    if (pool) {
+      pool->parallel_for(count, test, 64);
+    } else {
+      for (int i = 0; i < count; i++) test(i);
+    }
+
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+      if (!hits[i]) continue;
+      total++;
+      if (spheres[i].on_collision) spheres[i].on_collision(contacts[i].point, contacts[i].normal);
+    }
+    return total;
+  }
+
+  bool line_of_sight(const glm::vec3& a, const glm::vec3& b) const {
+    const float distance = glm::length(b - a);
+    if (distance < collisions::EPSILON) return get_height(a) < a.y;
+
+    collisions::Ray ray;
+    ray.origin = a, ray.direction = (b - a) / distance;
+
+    float t;
+    return !raycast(ray, distance, &t);
+  }
+
+  const TerrainParams params;
+
+ private:
+  // height bounds of blocks of 2^level x 2^level texels, a texel covers uv [i / width, (i + 1) / width)
+  struct Level {
+    int width, height;
+    std::vector<float> min, max;
+  };
+
+  Image m_heightmap, m_normalmap;
+  QuantizedHeights m_quantized;               // replaces the heightmap texels when params.quantize_heights is set
+  std::shared_ptr<const TileSource> m_tiles;  // owns the texels of views
+  std::vector<Level> m_pyramid;
+
+  // texel offsets of the 2x2 texels around a sample and the blend weights between them
+  struct Footprint {
+    size_t t00, t10, t01, t11;
+    float fx, fy;
+  };
+
+  // written so that nan coordinates count as outside
+  static inline bool inside(const glm::vec2& uv) {
+    return uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+  }
+
+  // texel centers are at (i + 0.5) / size
+  static Footprint get_footprint(const Image& image, float fx, float fy, int x0, int y0) {
+    const int x1 = wrap(x0 + 1, image.width), y1 = wrap(y0 + 1, image.height);
+    x0 = wrap(x0, image.width), y0 = wrap(y0, image.height);
+
+    return {image.get_offset(x0, y0), image.get_offset(x1, y0), image.get_offset(x0, y1), image.get_offset(x1, y1),
+            fx, fy};
+  }
+
+  static Footprint get_footprint(const Image& image, const glm::vec2& uv) {
+    const float tx = uv.x * static_cast<float>(image.width) - 0.5f;
+    const float ty = uv.y * static_cast<float>(image.height) - 0.5f;
+    const float x0 = std::floor(tx), y0 = std::floor(ty);
+    return get_footprint(image, tx - x0, ty - y0, static_cast<int>(x0), static_cast<int>(y0));
+  }
+
+  // raw 16 bit height at a texel offset
+  inline float get_height_texel(size_t offset) const {
+    return static_cast<float>(m_quantized.empty() ? m_heightmap.get_texels<uint16_t>()[offset] : m_quantized[offset]);
+  }
+
+  // of the texels fetch returns for the offsets, not normalized
+  template <typename Fetch>
+  static inline float bilinear(const Footprint& f, Fetch fetch) {
+    const float t00 = fetch(f.t00), t10 = fetch(f.t10), t01 = fetch(f.t01), t11 = fetch(f.t11);
+    const float a = t00 + (t10 - t00) * f.fx;
+    const float b = t01 + (t11 - t01) * f.fx;
+    return a + (b - a) * f.fy;
+  }
+
+  // the filtered surface over a texel depends on its 8 neighbours. bounds get a small margin for rounding
+  void build_pyramid() {
+    if (m_heightmap.empty()) return;
+
+    const int w = m_heightmap.width, h = m_heightmap.height;
+    const float margin = params.height_scale * 1e-6f;
+
+    Level base{w, h, std::vector<float>(static_cast<size_t>(w) * h), std::vector<float>(static_cast<size_t>(w) * h)};
+
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            const float texel = get_height_texel(m_heightmap.get_offset(wrap(x + dx, w), wrap(y + dy, h))) / 65535.0f;
+            lo = std::min(lo, texel), hi = std::max(hi, texel);
+          }
+        }
+
+        base.min[static_cast<size_t>(y) * w + x] = lo * params.height_scale - margin;
+        base.max[static_cast<size_t>(y) * w + x] = hi * params.height_scale + margin;
+      }
+    }
+
+    m_pyramid.push_back(std::move(base));
+
+    while (m_pyramid.back().width > 1 || m_pyramid.back().height > 1) {
+      const auto& fine = m_pyramid.back();
+      Level level{(fine.width + 1) / 2, (fine.height + 1) / 2};
+      level.min.resize(static_cast<size_t>(level.width) * level.height);
+      level.max.resize(static_cast<size_t>(level.width) * level.height);
+
+      for (int y = 0; y < level.height; y++) {
+        for (int x = 0; x < level.width; x++) {
+          float lo = std::numeric_limits<float>::max(), hi = std::numeric_limits<float>::lowest();
+
+          for (int dy = 0; dy <= 1; dy++) {
+            for (int dx = 0; dx <= 1; dx++) {
+              const int fx = std::min(2 * x + dx, fine.width - 1), fy = std::min(2 * y + dy, fine.height - 1);
+              lo = std::min(lo, fine.min[static_cast<size_t>(fy) * fine.width + fx]);
+              hi = std::max(hi, fine.max[static_cast<size_t>(fy) * fine.width + fx]);
+            }
+          }
+
+          level.min[static_cast<size_t>(y) * level.width + x] = lo;
+          level.max[static_cast<size_t>(y) * level.width + x] = hi;
+        }
+      }
+
+      m_pyramid.push_back(std::move(level));
+    }
+  }
+
+  // part of the ray within [0, max_distance] that is above the heightmap
+  bool clip_to_map(const collisions::Ray& ray, float max_distance, float* enter, float* exit) const {
+    *enter = 0.0f, *exit = max_distance;
+
+    for (int axis : {0, 2}) {
+      if (std::abs(ray.direction[axis]) < collisions::EPSILON) {
+        if (std::abs(ray.origin[axis]) > params.extent) return false;
+        continue;
+      }
+
+      float t0 = (-params.extent - ray.origin[axis]) / ray.direction[axis];
+      float t1 = (params.extent - ray.origin[axis]) / ray.direction[axis];
+      if (t0 > t1) std::swap(t0, t1);
+
+      *enter = std::max(*enter, t0), *exit = std::min(*exit, t1);
+    }
+
+    return *enter <= *exit;
+  }
+
+  // descend into blocks the ray might touch and step over the ones it passes above
+  bool traverse(const collisions::Ray& ray, float enter, float exit, float* t) const {
+    // ray in texel units on the xz plane, p = uv * size
+    const glm::vec2 scale(0.5f * m_heightmap.width / params.extent, 0.5f * m_heightmap.height / params.extent);
+    const glm::vec2 p0 = (glm::vec2(ray.origin.x, ray.origin.z) + params.extent) * scale;
+    const glm::vec2 d = glm::vec2(ray.direction.x, ray.direction.z) * scale;
+
+    const int top = static_cast<int>(m_pyramid.size()) - 1;
+    int level = top;
+    float begin = enter;
+
+    while (begin < exit) {
+      const auto& bounds = m_pyramid[level];
+      const float block_size = static_cast<float>(1 << level);
+
+      const int cx = get_block(p0.x + d.x * begin, d.x, block_size, bounds.width);
+      const int cy = get_block(p0.y + d.y * begin, d.y, block_size, bounds.height);
+
+      float end = std::min(get_block_exit(p0.x, d.x, cx, block_size), get_block_exit(p0.y, d.y, cy, block_size));
+      end = std::min(end, exit);
+      end = std::max(end, std::nextafter(begin, std::numeric_limits<float>::max()));
+
+      const float lowest = std::min(ray.origin.y + ray.direction.y * begin, ray.origin.y + ray.direction.y * end);
+
+      if (lowest > bounds.max[static_cast<size_t>(cy) * bounds.width + cx]) {
+        begin = end;
+        level = std::min(level + 1, top);
+      } else if (level > 0) {
+        level--;
+      } else {
+        if (intersect_texel(ray, begin, end, p0, d, cx, cy, t)) return true;
+        begin = end;
+        level = std::min(level + 1, top);
+      }
+    }
+
+    return false;
+  }
+
+  // block along one axis that the ray enters at p, points on a boundary belong to the block ahead
+  static inline int get_block(float p, float d, float block_size, int count) {
+    const float q = p / block_size;
+    float block = std::floor(q);
+    if (block == q && d < 0.0f) block -= 1.0f;
+    return std::clamp(static_cast<int>(block), 0, count - 1);
+  }
+
+  static inline float get_block_exit(float p0, float d, int block, float block_size) {
+    if (d > 0.0f) return ((block + 1) * block_size - p0) / d;
+    if (d < 0.0f) return (block * block_size - p0) / d;
+    return std::numeric_limits<float>::max();
+  }
+
+  // the surface over a texel is made of up to 4 bilinear patches split at the texel center. along a straight
+  // line the height of a bilinear patch is a quadratic, so the ray is solved exactly for every piece
+  bool intersect_texel(const collisions::Ray& ray, float begin, float end, const glm::vec2& p0, const glm::vec2& d,
+                       int cx, int cy, float* t) const {
+    float splits[4] = {begin, end, end, end};
+    int count = 1;
+
+    for (int axis = 0; axis < 2; axis++) {
+      if (d[axis] == 0.0f) continue;
+      const float split = ((axis == 0 ? cx : cy) + 0.5f - p0[axis]) / d[axis];
+      if (split > begin && split < end) splits[count++] = split;
+    }
+    std::sort(splits + 1, splits + count);
+    splits[count] = end;
+
+    auto above = [this, &ray](float distance) {
+      const auto point = ray.origin + ray.direction * distance;
+      return point.y - get_height(glm::vec2(point.x, point.z));
+    };
+
+    for (int i = 0; i < count; i++) {
+      const float a = splits[i], b = splits[i + 1];
+      const float f0 = above(a), fm = above(0.5f * (a + b)), f1 = above(b);
+
+      if (f0 <= 0.0f) {
+        *t = a;
+        return true;
+      }
+
+      float s;
+      if (solve_quadratic(f0, fm, f1, &s)) {
+        *t = a + (b - a) * s;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  // first root in [0, 1] of the quadratic through f(0) = f0, f(0.5) = fm, f(1) = f1 with f0 > 0
+  static bool solve_quadratic(float f0, float fm, float f1, float* s) {
+    const float a = 2.0f * f0 - 4.0f * fm + 2.0f * f1;
+    const float b = 4.0f * fm - 3.0f * f0 - f1;
+    const float c = f0;
+
+    float roots[2];
+    int count = 0;
+
+    if (std::abs(a) < 1e-6f * (std::abs(b) + std::abs(c))) {
+      if (b != 0.0f) roots[count++] = -c / b;
+    } else {
+      const float discriminant = b * b - 4.0f * a * c;
+      if (discriminant >= 0.0f) {
+        // numerically stable form, the roots are q / a and c / q
+        const float q = -0.5f * (b + std::copysign(std::sqrt(discriminant), b));
+        roots[count++] = q / a;
+        if (q != 0.0f) roots[count++] = c / q;
+      }
+    }
+
+    float first = std::numeric_limits<float>::max();
+    for (int i = 0; i < count; i++) {
+      if (roots[i] >= 0.0f && roots[i] <= 1.0f) first = std::min(first, roots[i]);
+    }
+
+    // rounding can push the crossing of a piece that ends below the terrain out of [0, 1]
+    if (first > 1.0f && f1 <= 0.0f) first = f0 / (f0 - f1);
+
+    *s = first;
+    return first <= 1.0f;
+  }
+
+#if SIMD_SSE2
+  inline void get_uv4(const float* x, const float* z, __m128* u, __m128* v) const {
+    const __m128 extent = _mm_set1_ps(params.extent), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    *u = _mm_mul_ps(_mm_add_ps(_mm_div_ps(_mm_loadu_ps(x), extent), one), half);
+    *v = _mm_mul_ps(_mm_add_ps(_mm_div_ps(_mm_loadu_ps(z), extent), one), half);
+  }
+
+  // bilinear samples of every channel of the image at 4 texture coordinates, texels are gathered one by one through
+  // fetch and not normalized
+  template <typename Fetch>
+  static void sample4(const Image& image, __m128 u, __m128 v, Fetch fetch, __m128* result) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    const auto tx = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(image.width))), half);
+    const auto ty = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(image.height))), half);
+    const auto x0 = simd::floor(tx), y0 = simd::floor(ty);
+    const auto fx = _mm_sub_ps(tx, x0), fy = _mm_sub_ps(ty, y0);
+
+    alignas(16) int ix[4], iy[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(ix), _mm_cvttps_epi32(x0));
+    _mm_store_si128(reinterpret_cast<__m128i*>(iy), _mm_cvttps_epi32(y0));
+
+    Footprint footprints[4];
+    for (int k = 0; k < 4; k++) footprints[k] = get_footprint(image, 0.0f, 0.0f, ix[k], iy[k]);
+
+    for (int c = 0; c < image.channels; c++) {
+      alignas(16) float t00[4], t10[4], t01[4], t11[4];
+
+      for (int k = 0; k < 4; k++) {
+        const auto& f = footprints[k];
+        t00[k] = fetch(f.t00 + c), t10[k] = fetch(f.t10 + c), t01[k] = fetch(f.t01 + c), t11[k] = fetch(f.t11 + c);
+      }
+
+      const auto a = simd::lerp(_mm_load_ps(t00), _mm_load_ps(t10), fx);
+      const auto b = simd::lerp(_mm_load_ps(t01), _mm_load_ps(t11), fx);
+      result[c] = simd::lerp(a, b, fy);
+    }
+  }
+#endif
+};
+};  // namespace terrain
@@ -0,0 +1,253 @@
+/*
+    Unit tests for terrain.h, the fields are made from images in memory
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "terrain.h"
+#include "unittest.h"
+
+namespace terrain {
+
+inline int run_unit_tests() {
+  const int failures = unittest::failures;
+  std::mt19937 rng(5);
+
+  // smooth hills with noise, every fourth row of tiles is flat up to a few steps
+  const int width = 200, height = 130;
+  std::vector<uint16_t> texels(static_cast<size_t>(width) * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const float hills = 32767.0f + 30000.0f * std::sin(x * 0.05f) * std::cos(y * 0.07f);
+      const int noise = static_cast<int>(rng() % 601) - 300;
+      const int value = (y / 32) % 4 == 3 ? 20000 + static_cast<int>(rng() % 200) : static_cast<int>(hills) + noise;
+      texels[static_cast<size_t>(y) * width + x] = static_cast<uint16_t>(std::clamp(value, 0, 65535));
+    }
+  }
+
+  const Image heightmap(width, height, 1, 2, 64, reinterpret_cast<const uint8_t*>(texels.data()), 1);
+  const uint16_t* exact = heightmap.get_texels<uint16_t>();
+  const size_t count = heightmap.get_bytes() / 2;
+
+  // runs that span at most 255 are exact, others are off by at most half a step
+  const QuantizedHeights quantized(exact, count);
+  int max_error = 0, exact_runs = 0;
+
+  for (size_t begin = 0; begin < count; begin += QuantizedHeights::RUN) {
+    const size_t end = std::min(begin + QuantizedHeights::RUN, count);
+    const auto [lo, hi] = std::minmax_element(exact + begin, exact + end);
+    const int range = *hi - *lo, step = std::max(1, (range + 254) / 255);
+    exact_runs += range <= 255;
+
+    for (size_t i = begin; i < end; i++) {
+      const int error = std::abs(quantized[i] - exact[i]);
+      CHECK(range <= 255 ? error == 0 : 2 * error <= step);
+      max_error = std::max(max_error, error);
+    }
+  }
+  CHECK(exact_runs > 0 && max_error > 0);
+  CHECK(quantized.get_bytes() < count * 2 * 6 / 10);
+
+  // fields with and without quantized heights agree within the largest error, batches agree with single queries
+  const TerrainParams params{3000.0f, 1000.0f};
+  const TerrainParams quantized_params{3000.0f, 1000.0f, true};
+  const TerrainField field(heightmap.view(), Image(), params);
+  const TerrainField quantized_field(
+      Image(width, height, 1, 2, 64, reinterpret_cast<const uint8_t*>(texels.data()), 1), Image(), quantized_params);
+
+  const float tolerance = (max_error + 0.01f) * params.height_scale / 65535.0f;
+  std::uniform_real_distribution<float> coordinate(-1100.0f, 1100.0f);
+  std::vector<float> x(1003), z(1003), heights(1003);
+
+  for (int i = 0; i < 1003; i++) {
+    x[i] = coordinate(rng), z[i] = coordinate(rng);
+    const glm::vec2 point(x[i], z[i]);
+    CHECK(std::abs(field.get_height(point) - quantized_field.get_height(point)) <= tolerance);
+  }
+
+  quantized_field.get_heights(x.data(), z.data(), 1003, heights.data());
+  for (int i = 0; i < 1003; i++) CHECK(heights[i] == quantized_field.get_height(glm::vec2(x[i], z[i])));
+
+  // the simd lookups of a field with exact heights and a normal map agree with the scalar ones, on and off the map
+  // and for counts that leave a scalar tail
+  const int normal_width = 97, normal_height = 61;
+  std::vector<uint8_t> normal_texels(static_cast<size_t>(normal_width) * normal_height * 3);
+  for (size_t i = 0; i < normal_texels.size(); i++) {
+    normal_texels[i] = static_cast<uint8_t>(i % 3 == 1 ? 128 + rng() % 128 : rng() % 256);
+  }
+
+  const TerrainField lit_field(heightmap.view(), Image(normal_width, normal_height, 3, 1, 32, normal_texels.data(), 3),
+                               params);
+  const float edges[] = {-1000.0f, 1000.0f, -1000.5f, 1000.5f, 1e5f, -1e5f};
+  for (int i = 0; i < 60; i++) x[i] = edges[i % 6], z[i] = edges[(i / 6) % 6];
+
+  std::vector<float> nx(1003), ny(1003), nz(1003);
+  for (const int lookups : {1003, 5, 3}) {
+    lit_field.get_heights(x.data(), z.data(), lookups, heights.data());
+    lit_field.get_normals(x.data(), z.data(), lookups, nx.data(), ny.data(), nz.data());
+
+    for (int i = 0; i < lookups; i++) {
+      const glm::vec2 point(x[i], z[i]);
+      CHECK(std::abs(heights[i] - lit_field.get_height(point)) <= 1e-3f);
+
+      const auto normal = lit_field.get_normal(point);
+      CHECK(glm::length(glm::vec3(nx[i], ny[i], nz[i]) - normal) <= 1e-5f);
+    }
+  }
+
+  // raycasts against a fine march along the ray. a hit crosses the surface within a centimeter and is no later
+  // than the first sample clearly below it, a miss has no such sample. the cliffs at the flat rows are steep
+  auto above = [&field](const collisions::Ray& ray, float distance) {
+    const auto point = ray.origin + ray.direction * distance;
+    return point.y - field.get_height(glm::vec2(point.x, point.z));
+  };
+
+  const float max_distance = 2500.0f, step = 0.1f;
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f), altitude(-100.0f, 3500.0f);
+  std::vector<collisions::Ray> rays;
+
+  auto add_ray = [&rays](const glm::vec3& origin, const glm::vec3& direction) {
+    collisions::Ray ray;
+    ray.origin = origin, ray.direction = glm::normalize(direction);
+    rays.push_back(ray);
+  };
+
+  for (int i = 0; i < 150; i++) {
+    add_ray(glm::vec3(coordinate(rng), altitude(rng), coordinate(rng)), glm::vec3(unit(rng), unit(rng), unit(rng)));
+  }
+  for (int i = 0; i < 20; i++) {
+    // below the terrain, and from far off the map across it and out again
+    const glm::vec2 point(coordinate(rng), coordinate(rng));
+    add_ray(glm::vec3(point.x, field.get_height(point) - 5.0f, point.y), glm::vec3(unit(rng), unit(rng), unit(rng)));
+    add_ray(glm::vec3(-1800.0f, 500.0f + 3000.0f * (unit(rng) + 1.0f), coordinate(rng)),
+            glm::vec3(1.0f, -0.5f * (unit(rng) + 1.0f), 0.2f * unit(rng)));
+  }
+  for (int i = 0; i < 20; i++) {
+    // along the axes, and on the edges of texels and blocks which are multiples of 10 m
+    const float edge = -1000.0f + 10.0f * static_cast<float>(rng() % 201);
+    add_ray(glm::vec3(edge, altitude(rng), coordinate(rng)), glm::vec3(0.0f, -0.2f * (unit(rng) + 1.0f), 1.0f));
+    add_ray(glm::vec3(coordinate(rng), altitude(rng), edge), glm::vec3(-1.0f, -0.2f * (unit(rng) + 1.0f), 0.0f));
+    add_ray(glm::vec3(edge, altitude(rng), edge), glm::vec3(0.0f, -1.0f, 0.0f));
+    add_ray(glm::vec3(edge, 3100.0f, -1000.0f), glm::vec3(-1.0f, -0.5f * (unit(rng) + 1.0f), 1.0f));
+  }
+
+  int ray_hits = 0;
+  std::vector<float> ray_t(rays.size());
+  for (size_t i = 0; i < rays.size(); i++) {
+    const auto& ray = rays[i];
+    const bool hit = field.raycast(ray, max_distance, &ray_t[i]);
+    ray_hits += hit;
+
+    float first = std::numeric_limits<float>::max();
+    for (float distance = 0.0f; distance <= max_distance; distance += step) {
+      if (above(ray, distance) < -0.01f) {
+        first = distance;
+        break;
+      }
+    }
+
+    if (hit) {
+      CHECK(ray_t[i] >= 0.0f && ray_t[i] <= max_distance && ray_t[i] <= first);
+      const float before = above(ray, std::max(ray_t[i] - 0.01f, 0.0f)), after = above(ray, ray_t[i] + 0.01f);
+      CHECK((before > -0.01f && after < 0.01f) || (ray_t[i] == 0.0f && above(ray, 0.0f) <= 0.0f));
+    } else {
+      CHECK(first == std::numeric_limits<float>::max() && ray_t[i] == std::numeric_limits<float>::max());
+    }
+  }
+  CHECK(ray_hits > 0 && ray_hits < static_cast<int>(rays.size()));
+
+  // batches give the same distances as single rays, with and without a pool
+  const int ray_count = static_cast<int>(rays.size());
+  std::vector<float> ox(ray_count), oy(ray_count), oz(ray_count), dx(ray_count), dy(ray_count), dz(ray_count);
+  for (int i = 0; i < ray_count; i++) {
+    ox[i] = rays[i].origin.x, oy[i] = rays[i].origin.y, oz[i] = rays[i].origin.z;
+    dx[i] = rays[i].direction.x, dy[i] = rays[i].direction.y, dz[i] = rays[i].direction.z;
+  }
+
+  const collisions::RayBatch batch{{ox.data(), oy.data(), oz.data()}, {dx.data(), dy.data(), dz.data()}};
+  jobs::ThreadPool pool(2);
+
+  for (auto* batch_pool : {static_cast<jobs::ThreadPool*>(nullptr), &pool}) {
+    std::vector<float> t(ray_count);
+    std::vector<uint8_t> hits(ray_count);
+    CHECK(field.raycast(batch, max_distance, ray_count, t.data(), hits.data(), batch_pool) == ray_hits);
+    for (int i = 0; i < ray_count; i++) CHECK(t[i] == ray_t[i] && hits[i] == (ray_t[i] <= max_distance));
+  }
+
+  // sweeps over a ramp that rises along x, bilinear filtering keeps it planar away from the edges. a sphere moving
+  // into the slope, one that starts below it and one far above it that is rejected
+  std::vector<uint16_t> ramp(64 * 64);
+  for (size_t i = 0; i < ramp.size(); i++) ramp[i] = static_cast<uint16_t>(1000 + 100 * (i % 64));
+  const TerrainField ramp_field(Image(64, 64, 1, 2, 32, reinterpret_cast<const uint8_t*>(ramp.data()), 1), Image(),
+                                TerrainParams{3000.0f, 320.0f});
+
+  auto ramp_height = [&ramp_field](const glm::vec3& point) { return ramp_field.get_height(point); };
+  const float slope = (ramp_height(glm::vec3(50.0f, 0.0f, 0.0f)) - ramp_height(glm::vec3(-50.0f, 0.0f, 0.0f))) / 100.0f;
+  const glm::vec3 ramp_normal = glm::normalize(glm::vec3(-slope, 1.0f, 0.0f));
+
+  static std::vector<glm::vec3> reported;
+  auto make_sphere = [](const glm::vec3& center) {
+    collisions::Sphere sphere;
+    sphere.center = center, sphere.radius = 1.0f;
+    sphere.on_collision = [](const glm::vec3& point, const glm::vec3&) { reported.push_back(point); };
+    return sphere;
+  };
+
+  const collisions::Sphere spheres[] = {
+      make_sphere(glm::vec3(0.0f, ramp_height(glm::vec3(0.0f)) + 10.0f, 0.0f)),
+      make_sphere(glm::vec3(10.0f, ramp_height(glm::vec3(10.0f, 0.0f, 40.0f)) - 0.5f, 40.0f)),
+      make_sphere(glm::vec3(0.0f, 5000.0f, 0.0f)),
+  };
+  const glm::vec3 sweep_displacements[] = {glm::vec3(30.0f, -5.0f, 0.0f), glm::vec3(0.0f, -1.0f, 5.0f),
+                                           glm::vec3(30.0f, -5.0f, 0.0f)};
+
+  // the lowest point of the sphere moves along the displacement until it meets the plane
+  const glm::vec3 lowest = spheres[0].center - ramp_normal, direction = glm::normalize(sweep_displacements[0]);
+  const float distance = (lowest.y - ramp_height(lowest)) / (slope * direction.x - direction.y);
+  const float expected_t = distance / glm::length(sweep_displacements[0]);
+  const glm::vec3 expected_points[] = {lowest + direction * distance,
+                                       glm::vec3(spheres[1].center.x + slope / glm::length(glm::vec2(slope, 1.0f)),
+                                                 0.0f, spheres[1].center.z)};
+
+  Contact sweep_contacts[3];
+  reported.clear();
+  CHECK(ramp_field.sweep(spheres[0], sweep_displacements[0], &sweep_contacts[0]));
+  CHECK(ramp_field.sweep(spheres[1], sweep_displacements[1], &sweep_contacts[1]));
+  CHECK(!ramp_field.sweep(spheres[2], sweep_displacements[2], &sweep_contacts[2]));
+  CHECK(reported.empty());
+
+  CHECK(expected_t > 0.1f && expected_t < 0.9f && std::abs(sweep_contacts[0].t - expected_t) < 1e-3f);
+  CHECK(sweep_contacts[1].t == 0.0f);
+  for (int i = 0; i < 2; i++) {
+    const auto& point = sweep_contacts[i].point;
+    CHECK(std::abs(point.x - expected_points[i].x) < 1e-2f && std::abs(point.z - expected_points[i].z) < 1e-2f);
+    CHECK(std::abs(point.y - ramp_height(point)) < 1e-2f);
+    CHECK(glm::length(sweep_contacts[i].normal - ramp_normal) < 1e-3f);
+  }
+
+  // batches find the same contacts and report the hits in order on the calling thread
+  for (auto* sweep_pool : {static_cast<jobs::ThreadPool*>(nullptr), &pool}) {
+    Contact batch_contacts[3];
+    uint8_t sweep_hits[3];
+    reported.clear();
+
+    CHECK(ramp_field.sweep(spheres, sweep_displacements, 3, batch_contacts, sweep_hits, sweep_pool) == 2);
+    CHECK(sweep_hits[0] && sweep_hits[1] && !sweep_hits[2]);
+    CHECK(reported.size() == 2);
+
+    for (int i = 0; i < 2 && i < static_cast<int>(reported.size()); i++) {
+      CHECK(batch_contacts[i].t == sweep_contacts[i].t && batch_contacts[i].point == sweep_contacts[i].point);
+      CHECK(reported[i] == sweep_contacts[i].point);
+    }
+  }
+
+  return unittest::report("terrain", failures);
+}
+};  // namespace terrain
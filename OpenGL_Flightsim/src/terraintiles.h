@@ -0,0 +1,561 @@
+/*
+    Terrain cut into square tiles of a mip pyramid. the pyramid is built from the terrain images once and cached in a
+    tile file that is memory mapped afterwards, tiles are served straight from memory to the loader thread of the
+    clipmap textures and to the cpu queries
+*/
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../lib/stb_image.h"
+#include "mappedfile.h"
+
+#define BUILD_TERRAIN_TILES 0
+
+namespace terrain {
+
+// every tile has all of these
+enum Layer { HEIGHT, NORMAL, ALBEDO, LAYER_COUNT };
+
+struct LayerFormat {
+  int channels;
+  int bytes;  // per channel
+};
+
+// keep in sync with the clipmap textures. 16 bit heights are steps of 5 cm over 3000 m, 8 bit ones were 12 m
+constexpr LayerFormat LAYER_FORMATS[LAYER_COUNT] = {{1, 2}, {3, 1}, {3, 1}};
+
+// texel bytes of a layer whose image is missing, normals are used without remapping so up is (0, 1, 0)
+constexpr uint8_t DEFAULT_TEXELS[LAYER_COUNT][6] = {{0, 0}, {0, 255, 0}, {0, 0, 0}};
+
+constexpr int DEFAULT_TILE_SIZE = 128;
+
+inline size_t get_texel_size(Layer layer) {
+  return static_cast<size_t>(LAYER_FORMATS[layer].channels) * LAYER_FORMATS[layer].bytes;
+}
+
+inline int wrap(int i, int size) {
+  i %= size;
+  return i < 0 ? i + size : i;
+}
+
+// 8 or 16 bit texels of one layer in square tiles, row major inside of a tile with interleaved channels. partial tiles
+// at the edges are padded with the texels that wrap around. images either own their texels or view memory that
+// someone else keeps alive, e.g. a mapped tile file
+class Image {
+ public:
+  int width = 0, height = 0, channels = 0;
+  int bytes = 1;                             // per channel
+  int tile_size = 0, columns = 0, rows = 0;  // tiles per row and column
+
+  Image() = default;
+
+  // without texels, tile_size has to be a power of two
+  Image(int w, int h, int c, int b, int tile) : width(w), height(h), channels(c), bytes(b), tile_size(tile) {
+    assert(tile_size > 0 && (tile_size & (tile_size - 1)) == 0);
+    columns = (width + tile_size - 1) / tile_size, rows = (height + tile_size - 1) / tile_size;
+    while ((1 << m_shift) < tile_size) m_shift++;
+  }
+
+  // row major texels with source_channels channels, keeps the first c channels
+  Image(int w, int h, int c, int b, int tile, const uint8_t* texels, int source_channels) : Image(w, h, c, b, tile) {
+    m_storage.resize(get_bytes());
+
+    const size_t source_size = static_cast<size_t>(source_channels) * bytes, size = static_cast<size_t>(c) * bytes;
+    for (int y = 0; y < rows * tile_size; y++) {
+      const uint8_t* row = texels + static_cast<size_t>(wrap(y, height)) * width * source_size;
+      for (int x = 0; x < columns * tile_size; x++) {
+        const uint8_t* source = row + static_cast<size_t>(wrap(x, width)) * source_size;
+        std::memcpy(&m_storage[get_offset(x, y) * bytes], source, size);
+      }
+    }
+  }
+
+  // decoded with stb_image, 8 bit files are scaled up to 16 bit ones. images that fail to load are a single fallback
+  // texel
+  Image(const std::string& path, int c, int b, int tile, const uint8_t* fallback) {
+    int w, h, source_channels;
+    void* data = b == 2 ? static_cast<void*>(stbi_load_16(path.c_str(), &w, &h, &source_channels, 0))
+                        : static_cast<void*>(stbi_load(path.c_str(), &w, &h, &source_channels, 0));
+
+    if (data && source_channels >= c) {
+      *this = Image(w, h, c, b, tile, static_cast<const uint8_t*>(data), source_channels);
+    } else {
+      std::cout << "Failed to load terrain " << path << std::endl;
+      *this = Image(1, 1, c, b, tile, fallback, c);
+    }
+    stbi_image_free(data);
+  }
+
+  // texels in the same layout that outlive the view
+  static Image view(int w, int h, int c, int b, int tile, const uint8_t* texels) {
+    Image image(w, h, c, b, tile);
+    image.m_view = texels;
+    return image;
+  }
+
+  inline Image view() const { return view(width, height, channels, bytes, tile_size, get_data()); }
+
+  inline bool empty() const { return width == 0 || height == 0; }
+  inline bool is_view() const { return m_view != nullptr; }
+  inline const uint8_t* get_data() const { return m_view ? m_view : m_storage.data(); }
+  inline size_t get_tile_bytes() const { return static_cast<size_t>(tile_size) * tile_size * channels * bytes; }
+  inline size_t get_bytes() const { return get_tile_bytes() * columns * rows; }
+
+  // channels as uint8_t or uint16_t
+  template <typename T>
+  inline const T* get_texels() const {
+    assert(sizeof(T) == static_cast<size_t>(bytes));
+    return reinterpret_cast<const T*>(get_data());
+  }
+
+  // of the first channel of a texel in channels, x and y are within the tiles
+  inline size_t get_offset(int x, int y) const {
+    const size_t tile = static_cast<size_t>(y >> m_shift) * columns + (x >> m_shift);
+    const int mask = tile_size - 1;
+    return (tile * tile_size * tile_size + static_cast<size_t>(y & mask) * tile_size + (x & mask)) * channels;
+  }
+
+  inline const uint8_t* get_texel(int x, int y) const { return get_data() + get_offset(x, y) * bytes; }
+
+  // tiles outside of the image wrap around
+  inline const uint8_t* get_tile(int x, int y) const {
+    return get_data() + (static_cast<size_t>(wrap(y, rows)) * columns + wrap(x, columns)) * get_tile_bytes();
+  }
+
+ private:
+  int m_shift = 0;
+  std::vector<uint8_t> m_storage;
+  const uint8_t* m_view = nullptr;
+};
+
+struct TileKey {
+  int level = 0;
+  int x = 0, y = 0;  // in tiles, may be outside of the level
+
+  bool operator==(const TileKey& other) const { return level == other.level && x == other.x && y == other.y; }
+};
+
+// texels of every layer of a tile, they belong to the source
+struct Tile {
+  TileKey key;
+  const uint8_t* layers[LAYER_COUNT] = {};
+};
+
+// level 0 has the full resolution and every level halves it, all layers have the size of the heightmap. tiles outside
+// of a level wrap around like GL_REPEAT
+class TileSource {
+ public:
+  virtual ~TileSource() = default;
+
+  inline int get_tile_size() const { return m_tile_size; }
+  inline int get_levels() const { return static_cast<int>(m_images[HEIGHT].size()); }
+  inline const Image& get_image(Layer layer, int level) const { return m_images[layer][level]; }
+
+  inline glm::ivec2 get_size(int level) const {
+    return {m_images[HEIGHT][level].width, m_images[HEIGHT][level].height};
+  }
+
+  // lowest (x) and highest (y) height texel of a tile, normalized to [0, 1]
+  inline glm::vec2 get_height_bounds(const TileKey& key) const {
+    const auto& image = m_images[HEIGHT][key.level];
+    const size_t tile = static_cast<size_t>(wrap(key.y, image.rows)) * image.columns + wrap(key.x, image.columns);
+    return {m_bounds[key.level][2 * tile], m_bounds[key.level][2 * tile + 1]};
+  }
+
+  // points the tile at its texels and touches every page of them, so a mapped file is paged in on the calling thread
+  // instead of the one that uploads the tile
+  void read(const TileKey& key, Tile& tile) const {
+    tile.key = key;
+    for (int l = 0; l < LAYER_COUNT; l++) {
+      const auto& image = m_images[l][key.level];
+      tile.layers[l] = image.get_tile(key.x, key.y);
+
+      const volatile uint8_t* texels = tile.layers[l];
+      for (size_t i = 0; i < image.get_tile_bytes(); i += 4096) texels[i];
+    }
+  }
+
+ protected:
+  int m_tile_size = 0;
+  std::vector<Image> m_images[LAYER_COUNT];
+  std::vector<const float*> m_bounds;  // min and max of every tile of a level
+};
+
+// pyramid of the three terrain images built in memory, what a tile file is written from
+class ImagePyramid : public TileSource {
+ public:
+  ImagePyramid(const std::string& heightmap_path, const std::string& normalmap_path, const std::string& albedo_path,
+               int tile_size = DEFAULT_TILE_SIZE) {
+    m_tile_size = tile_size;
+
+    const std::string paths[LAYER_COUNT] = {heightmap_path, normalmap_path, albedo_path};
+    for (int l = 0; l < LAYER_COUNT; l++) {
+      const auto& format = LAYER_FORMATS[l];
+      m_images[l].push_back(Image(paths[l], format.channels, format.bytes, tile_size, DEFAULT_TEXELS[l]));
+    }
+
+    // the other layers are resampled to the size of the heightmap
+    const auto& base = m_images[HEIGHT][0];
+    for (int l = NORMAL; l < LAYER_COUNT; l++) m_images[l][0] = resize(m_images[l][0], base.width, base.height);
+
+    while (m_images[HEIGHT].back().width > 1 || m_images[HEIGHT].back().height > 1) {
+      for (auto& levels : m_images) levels.push_back(downsample(levels.back()));
+    }
+
+    for (const auto& image : m_images[HEIGHT]) m_bound_storage.push_back(get_bounds(image));
+    for (const auto& bounds : m_bound_storage) m_bounds.push_back(bounds.data());
+  }
+
+ private:
+  std::vector<std::vector<float>> m_bound_storage;
+
+  // row major copy of the texels inside of the image
+  static std::vector<uint8_t> get_texels(const Image& image) {
+    const size_t size = static_cast<size_t>(image.channels) * image.bytes;
+    std::vector<uint8_t> texels(static_cast<size_t>(image.width) * image.height * size);
+    for (int y = 0; y < image.height; y++) {
+      for (int x = 0; x < image.width; x++) {
+        std::memcpy(&texels[(static_cast<size_t>(y) * image.width + x) * size], image.get_texel(x, y), size);
+      }
+    }
+    return texels;
+  }
+
+  // nearest neighbour, only needed when the images of a terrain don't have the same size
+  static Image resize(const Image& image, int width, int height) {
+    if (image.width == width && image.height == height) return image;
+
+    const auto source = get_texels(image);
+    const size_t size = static_cast<size_t>(image.channels) * image.bytes;
+    std::vector<uint8_t> texels(static_cast<size_t>(width) * height * size);
+    for (int y = 0; y < height; y++) {
+      const int sy = static_cast<int>(static_cast<int64_t>(y) * image.height / height);
+      for (int x = 0; x < width; x++) {
+        const int sx = static_cast<int>(static_cast<int64_t>(x) * image.width / width);
+        std::memcpy(&texels[(static_cast<size_t>(y) * width + x) * size],
+                    &source[(static_cast<size_t>(sy) * image.width + sx) * size], size);
+      }
+    }
+    return Image(width, height, image.channels, image.bytes, image.tile_size, texels.data(), image.channels);
+  }
+
+  static Image downsample(const Image& fine) {
+    return fine.bytes == 2 ? downsample<uint16_t>(fine) : downsample<uint8_t>(fine);
+  }
+
+  // average of 2x2 texels, the last row and column are repeated for odd sizes
+  template <typename T>
+  static Image downsample(const Image& fine) {
+    const int width = (fine.width + 1) / 2, height = (fine.height + 1) / 2, channels = fine.channels;
+    const T* t = fine.get_texels<T>();
+    std::vector<T> texels(static_cast<size_t>(width) * height * channels);
+
+    for (int y = 0; y < height; y++) {
+      const int y0 = 2 * y, y1 = std::min(2 * y + 1, fine.height - 1);
+      for (int x = 0; x < width; x++) {
+        const int x0 = 2 * x, x1 = std::min(2 * x + 1, fine.width - 1);
+        const size_t t00 = fine.get_offset(x0, y0), t10 = fine.get_offset(x1, y0);
+        const size_t t01 = fine.get_offset(x0, y1), t11 = fine.get_offset(x1, y1);
+
+        for (int k = 0; k < channels; k++) {
+          const uint32_t sum = t[t00 + k] + t[t10 + k] + t[t01 + k] + t[t11 + k];
+          texels[(static_cast<size_t>(y) * width + x) * channels + k] = static_cast<T>((sum + 2) / 4);
+        }
+      }
+    }
+    return Image(width, height, channels, fine.bytes, fine.tile_size, reinterpret_cast<const uint8_t*>(texels.data()),
+                 channels);
+  }
+
+  // min and max of the heights of every tile that are inside of the image
+  static std::vector<float> get_bounds(const Image& image) {
+    const uint16_t* heights = image.get_texels<uint16_t>();
+    std::vector<float> bounds(2 * static_cast<size_t>(image.columns) * image.rows);
+
+    for (int ty = 0; ty < image.rows; ty++) {
+      for (int tx = 0; tx < image.columns; tx++) {
+        int lo = 65535, hi = 0;
+        for (int y = ty * image.tile_size; y < std::min((ty + 1) * image.tile_size, image.height); y++) {
+          for (int x = tx * image.tile_size; x < std::min((tx + 1) * image.tile_size, image.width); x++) {
+            const int texel = heights[image.get_offset(x, y)];
+            lo = std::min(lo, texel), hi = std::max(hi, texel);
+          }
+        }
+
+        const size_t tile = static_cast<size_t>(ty) * image.columns + tx;
+        bounds[2 * tile] = lo / 65535.0f, bounds[2 * tile + 1] = hi / 65535.0f;
+      }
+    }
+    return bounds;
+  }
+};
+
+// a header, a table of levels and then the layers and tile bounds of every level. a layer is the tiles of an image
+// back to back and starts on a page of its own
+constexpr uint32_t TILE_FILE_MAGIC = 0x454c4954;  // "TILE"
+constexpr uint32_t TILE_FILE_VERSION = 2;
+constexpr uint64_t TILE_FILE_ALIGNMENT = 4096;
+
+struct TileFileHeader {
+  uint32_t magic, version;
+  int32_t tile_size, levels;
+  LayerFormat formats[LAYER_COUNT];
+};
+
+struct TileFileLevel {
+  int32_t width, height, columns, rows;
+  uint64_t layers[LAYER_COUNT];  // offsets in the file
+  uint64_t bounds;
+};
+
+// pyramid that views a mapped tile file, opening it costs the mapping and nothing is read before it is used. files
+// that don't match the layer formats or are cut short stay closed
+class TileFile : public TileSource {
+ public:
+  explicit TileFile(const std::string& path) : m_file(path) {
+    if (m_file.empty() || m_file.size() < sizeof(TileFileHeader)) return;
+
+    TileFileHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (header.magic != TILE_FILE_MAGIC || header.version != TILE_FILE_VERSION || header.levels <= 0) return;
+    if (header.tile_size <= 0 || (header.tile_size & (header.tile_size - 1)) != 0) return;
+    for (int l = 0; l < LAYER_COUNT; l++) {
+      const auto& format = header.formats[l];
+      if (format.channels != LAYER_FORMATS[l].channels || format.bytes != LAYER_FORMATS[l].bytes) return;
+    }
+
+    const uint64_t table_end = sizeof(TileFileHeader) + sizeof(TileFileLevel) * static_cast<uint64_t>(header.levels);
+    if (m_file.size() < table_end) return;
+
+    std::vector<Image> images[LAYER_COUNT];
+    std::vector<const float*> bounds;
+
+    for (int i = 0; i < header.levels; i++) {
+      TileFileLevel level;
+      std::memcpy(&level, m_file.data() + sizeof(TileFileHeader) + sizeof(TileFileLevel) * i, sizeof(level));
+      if (level.width <= 0 || level.height <= 0) return;
+
+      for (int l = 0; l < LAYER_COUNT; l++) {
+        const auto& format = LAYER_FORMATS[l];
+        const auto image = Image::view(level.width, level.height, format.channels, format.bytes, header.tile_size,
+                                       m_file.data() + std::min<uint64_t>(level.layers[l], m_file.size()));
+        if (image.columns != level.columns || image.rows != level.rows) return;
+        if (!contains(level.layers[l], image.get_bytes())) return;
+        images[l].push_back(image);
+      }
+
+      const uint64_t bounds_size = 2 * sizeof(float) * static_cast<uint64_t>(level.columns) * level.rows;
+      if (level.bounds % alignof(float) != 0 || !contains(level.bounds, bounds_size)) return;
+      bounds.push_back(reinterpret_cast<const float*>(m_file.data() + level.bounds));
+    }
+
+    m_tile_size = header.tile_size;
+    for (int l = 0; l < LAYER_COUNT; l++) m_images[l] = std::move(images[l]);
+    m_bounds = std::move(bounds);
+  }
+
+  inline bool is_open() const { return !m_images[HEIGHT].empty(); }
+
+ private:
+  MappedFile m_file;
+
+  inline bool contains(uint64_t offset, uint64_t size) const {
+    return offset <= m_file.size() && m_file.size() - offset >= size;
+  }
+};
+
+// the offline part, writes the whole pyramid of source to path. returns false if the file couldn't be written
+inline bool write_tile_file(const TileSource& source, const std::string& path) {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) return false;
+
+  const int levels = source.get_levels();
+  TileFileHeader header{TILE_FILE_MAGIC, TILE_FILE_VERSION, source.get_tile_size(), levels, {}};
+  std::memcpy(header.formats, LAYER_FORMATS, sizeof(header.formats));
+
+  // offsets first, the data follows in the same order
+  std::vector<TileFileLevel> table(levels);
+  uint64_t offset = sizeof(TileFileHeader) + sizeof(TileFileLevel) * static_cast<uint64_t>(levels);
+
+  for (int i = 0; i < levels; i++) {
+    const auto& heightmap = source.get_image(HEIGHT, i);
+    auto& level = table[i];
+    level.width = heightmap.width, level.height = heightmap.height;
+    level.columns = heightmap.columns, level.rows = heightmap.rows;
+
+    for (int l = 0; l < LAYER_COUNT; l++) {
+      offset = (offset + TILE_FILE_ALIGNMENT - 1) / TILE_FILE_ALIGNMENT * TILE_FILE_ALIGNMENT;
+      level.layers[l] = offset;
+      offset += source.get_image(static_cast<Layer>(l), i).get_bytes();
+    }
+
+    level.bounds = offset;
+    offset += 2 * sizeof(float) * static_cast<uint64_t>(level.columns) * level.rows;
+  }
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(sizeof(TileFileLevel) * levels));
+
+  const std::vector<char> zeros(TILE_FILE_ALIGNMENT, 0);
+  for (int i = 0; i < levels; i++) {
+    for (int l = 0; l < LAYER_COUNT; l++) {
+      const auto& image = source.get_image(static_cast<Layer>(l), i);
+      const auto padding = table[i].layers[l] - static_cast<uint64_t>(file.tellp());
+      file.write(zeros.data(), static_cast<std::streamsize>(padding));
+      file.write(reinterpret_cast<const char*>(image.get_data()), static_cast<std::streamsize>(image.get_bytes()));
+    }
+
+    for (int y = 0; y < table[i].rows; y++) {
+      for (int x = 0; x < table[i].columns; x++) {
+        const auto bounds = source.get_height_bounds({i, x, y});
+        const float values[2] = {bounds.x, bounds.y};
+        file.write(reinterpret_cast<const char*>(values), sizeof(values));
+      }
+    }
+  }
+
+  return static_cast<bool>(file);
+}
+
+// tile file of a terrain made from a heightmap, its normal map and the imagery on top
+inline bool build_tile_file(const std::string& path, const std::string& heightmap_path,
+                            const std::string& normalmap_path, const std::string& albedo_path,
+                            int tile_size = DEFAULT_TILE_SIZE) {
+  return write_tile_file(ImagePyramid(heightmap_path, normalmap_path, albedo_path, tile_size), path);
+}
+
+// tiles of the terrain from the tile file at path, the file is built first when it is missing or older than one of
+// the images. images that don't exist don't count, so a terrain can ship as only the tile file. such a file is never
+// rebuilt, if it can't be opened the terrain is flat
+inline std::shared_ptr<const TileSource> load_tiles(const std::string& path, const std::string& heightmap_path,
+                                                    const std::string& normalmap_path, const std::string& albedo_path,
+                                                    int tile_size = DEFAULT_TILE_SIZE) {
+  namespace fs = std::filesystem;
+  std::error_code error;
+
+  bool fresh = fs::exists(path, error);
+  for (const auto* image : {&heightmap_path, &normalmap_path, &albedo_path}) {
+    if (fresh && fs::exists(*image, error) && fs::last_write_time(*image, error) > fs::last_write_time(path, error)) {
+      fresh = false;
+    }
+  }
+
+  // without a heightmap the file is used as it is, even if other images are newer
+  const bool buildable = fs::exists(heightmap_path, error);
+
+  if (fresh || !buildable) {
+    auto file = std::make_shared<TileFile>(path);
+    if (file->is_open() && file->get_tile_size() == tile_size) return file;
+  }
+
+  // a shipped tile file is never replaced by a pyramid of missing images, the terrain is flat until it is fixed
+  if (!buildable) {
+    std::cout << "Failed to load terrain tiles " << path << " and there is no heightmap to build them from"
+              << std::endl;
+    return std::make_shared<ImagePyramid>(heightmap_path, normalmap_path, albedo_path, tile_size);
+  }
+
+  // the pyramid is only kept if the file can't be written
+  auto pyramid = std::make_shared<ImagePyramid>(heightmap_path, normalmap_path, albedo_path, tile_size);
+  if (write_tile_file(*pyramid, path)) {
+    auto file = std::make_shared<TileFile>(path);
+    if (file->is_open()) return file;
+  }
+  return pyramid;
+}
+
+// reads requested tiles on its own thread, coarse levels first since finer levels fall back to them
+class TileLoader {
+ public:
+  explicit TileLoader(std::shared_ptr<const TileSource> source) : m_source(std::move(source)) {
+    m_thread = std::thread([this]() { work(); });
+  }
+
+  ~TileLoader() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+  }
+
+  TileLoader(const TileLoader&) = delete;
+  TileLoader& operator=(const TileLoader&) = delete;
+
+  const TileSource& get_source() const { return *m_source; }
+
+  void request(const TileKey& key) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_requests.push_back(key);
+    }
+    m_condition.notify_one();
+  }
+
+  // forget queued requests that are no longer wanted, tiles that are being read still arrive
+  template <typename Predicate>
+  void cancel_if(Predicate&& unwanted) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests.erase(std::remove_if(m_requests.begin(), m_requests.end(), unwanted), m_requests.end());
+  }
+
+  // move up to max_tiles finished tiles to the end of tiles, returns how many were moved
+  int poll(std::vector<Tile>& tiles, int max_tiles) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const int count = std::min(max_tiles, static_cast<int>(m_finished.size()));
+    for (int i = 0; i < count; i++) {
+      tiles.push_back(m_finished.front());
+      m_finished.pop_front();
+    }
+    return count;
+  }
+
+ private:
+  std::shared_ptr<const TileSource> m_source;
+  std::deque<TileKey> m_requests;
+  std::deque<Tile> m_finished;
+  bool m_quit = false;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::thread m_thread;
+
+  void work() {
+    for (;;) {
+      TileKey key;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return m_quit || !m_requests.empty(); });
+        if (m_quit) return;
+
+        auto next = std::max_element(m_requests.begin(), m_requests.end(),
+                                     [](const TileKey& a, const TileKey& b) { return a.level < b.level; });
+        key = *next;
+        m_requests.erase(next);
+      }
+
+      Tile tile;
+      m_source->read(key, tile);
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_finished.push_back(tile);
+    }
+  }
+};
+};  // namespace terrain
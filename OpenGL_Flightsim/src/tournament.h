@@ -0,0 +1,306 @@
+/*
+    Headless engagements between AI policies, run in parallel without a window
+*/
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <glm/gtx/vector_angle.hpp>
+#include <glm/vec3.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ai.h"
+#include "aircraft.h"
+#include "flightmodel.h"
+#include "jobs.h"
+#include "phi.h"
+#include "pid.h"
+
+#define RUN_TOURNAMENT 0
+
+namespace tournament {
+
+// sets the control inputs of one aircraft every step
+struct Policy {
+  virtual ~Policy() = default;
+  virtual void update(Airplane& self, const Airplane& target, phi::Seconds dt) = 0;
+};
+
+struct Agent {
+  std::string name;
+  std::function<std::unique_ptr<Policy>()> create;
+};
+
+struct Params {
+  int team_size = 1;                 // aircraft per team, 1 for 1v1
+  int rounds = 500;                  // engagements per pair of agents
+  phi::Seconds dt = 0.01f;           // fixed simulation step
+  phi::Seconds time_limit = 180.0f;  // engagement is a draw after this
+  phi::Seconds time_to_kill = 1.0f;  // target has to stay in the gun envelope this long
+  float gun_range = 1000.0f;         // m
+  phi::Radians gun_cone = 0.07f;     // half angle of the gun envelope, ~4 degrees
+  float separation = 6000.0f;        // initial distance between the teams, m
+  float min_altitude = 200.0f;       // anything below counts as a crash, m
+  float max_altitude = 11000.0f;     // the atmosphere model ends here, m
+  uint32_t seed = 1;
+};
+
+struct Score {
+  std::string name;
+  int engagements = 0, wins = 0, losses = 0, draws = 0;
+  int kills = 0, deaths = 0;
+  int crashes = 0;         // hit the ground or left the atmosphere model
+  double kill_time = 0.0;  // sum of engagement time at each kill, s
+  double cpu_time = 0.0;   // time spent in policy updates, s
+  long long decisions = 0;
+
+  float win_rate() const { return engagements > 0 ? static_cast<float>(wins) / engagements : 0.0f; }
+  double mean_time_to_kill() const { return kills > 0 ? kill_time / kills : 0.0; }
+  double cpu_time_per_decision() const { return decisions > 0 ? cpu_time / decisions : 0.0; }
+};
+
+// flies at the current position of the target
+struct Pursuit : public Policy {
+  void update(Airplane& self, const Airplane& target, phi::Seconds dt) override {
+    fly_towards(self, target.rigid_body.position);
+  }
+};
+
+// flies at the point where the target will be
+struct LeadPursuit : public Policy {
+  void update(Airplane& self, const Airplane& target, phi::Seconds dt) override { fly_towards(self, target); }
+};
+
+// banks the target into the lift vector and pulls towards it with pid controllers
+struct PIDPursuit : public Policy {
+  PID roll{1.5f, 0.0f, 0.2f}, pitch{3.0f, 0.2f, 0.5f}, yaw{1.0f, 0.0f, 0.1f};
+
+  void update(Airplane& self, const Airplane& target, phi::Seconds dt) override {
+    auto& rb = self.rigid_body;
+    auto direction = glm::normalize(rb.inverse_transform_direction(target.rigid_body.position - rb.position));
+
+    float bank_error = std::atan2(direction.z, std::max(direction.y, 0.0f) + phi::EPSILON);
+    float pitch_error = std::atan2(direction.y, direction.x);
+
+    // controllers drive the error towards zero
+    float aileron = roll.calculate(-bank_error, 0.0f, dt);
+    float elevator = pitch.calculate(-pitch_error, 0.0f, dt);
+    float rudder = yaw.calculate(-direction.z, 0.0f, dt);
+
+    self.joystick = glm::vec3(aileron, rudder, elevator);
+  }
+};
+
+std::vector<Agent> default_agents() {
+  return {
+      {"pursuit", []() { return std::make_unique<Pursuit>(); }},
+      {"lead_pursuit", []() { return std::make_unique<LeadPursuit>(); }},
+      {"pid_pursuit", []() { return std::make_unique<PIDPursuit>(); }},
+  };
+}
+
+struct TeamResult {
+  int kills = 0, deaths = 0, crashes = 0;
+  double kill_time = 0.0, cpu_time = 0.0;
+  long long decisions = 0;
+};
+
+struct Result {
+  int agents[2];
+  int winner = -1;  // team index, -1 for a draw
+  TeamResult teams[2];
+};
+
+struct Pilot {
+  int team;
+  Airplane airplane;
+  std::unique_ptr<Policy> policy;
+  bool alive = true;
+  int target = -1;
+  phi::Seconds time_on_target = 0.0f;
+};
+
+// simulate one engagement between two teams until one of them is gone or time runs out
+Result simulate(const Agent& a, const Agent& b, int index, const Params& params) {
+  std::mt19937 rng(params.seed + index);
+  std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+
+  std::vector<Pilot> pilots;
+  pilots.reserve(2 * params.team_size);
+
+  for (int team = 0; team < 2; team++) {
+    const float side = team == 0 ? -1.0f : 1.0f;
+    const float heading = (team == 0 ? 0.0f : phi::PI) + jitter(rng) * 0.5f;
+
+    for (int i = 0; i < params.team_size; i++) {
+      Pilot pilot{.team = team, .airplane = make_falcon(), .policy = (team == 0 ? a : b).create()};
+
+      auto& rb = pilot.airplane.rigid_body;
+      rb.position = glm::vec3(side * params.separation * 0.5f, 5000.0f + jitter(rng) * 1000.0f,
+                              static_cast<float>(i) * 300.0f + jitter(rng) * 500.0f);
+      rb.orientation = glm::angleAxis(heading, phi::UP);
+      rb.velocity = rb.forward() * 200.0f;
+      pilot.airplane.engine.throttle = 1.0f;
+
+      pilots.push_back(std::move(pilot));
+    }
+  }
+
+  Result result{.agents = {0, 0}};
+  int alive[2] = {params.team_size, params.team_size};
+  std::vector<int> shooters;
+  phi::Seconds time = 0.0f;
+
+  auto kill = [&](Pilot& pilot, bool crashed) {
+    pilot.alive = false;
+    pilot.airplane.rigid_body.active = false;
+    result.teams[pilot.team].deaths++;
+    result.teams[pilot.team].crashes += crashed ? 1 : 0;
+    alive[pilot.team]--;
+  };
+
+  for (; time < params.time_limit && alive[0] > 0 && alive[1] > 0; time += params.dt) {
+    for (auto& pilot : pilots) {
+      if (!pilot.alive) continue;
+
+      // always go after the closest enemy, time spent on another enemy doesn't count
+      float closest = std::numeric_limits<float>::max();
+      const int previous = pilot.target;
+      pilot.target = -1;
+      for (int j = 0; j < static_cast<int>(pilots.size()); j++) {
+        if (!pilots[j].alive || pilots[j].team == pilot.team) continue;
+
+        float distance = glm::length(pilots[j].airplane.rigid_body.position - pilot.airplane.rigid_body.position);
+        if (distance < closest) closest = distance, pilot.target = j;
+      }
+      if (pilot.target != previous) pilot.time_on_target = 0.0f;
+
+      auto& team = result.teams[pilot.team];
+      auto start = std::chrono::steady_clock::now();
+      pilot.policy->update(pilot.airplane, pilots[pilot.target].airplane, params.dt);
+      team.cpu_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      team.decisions++;
+
+      pilot.airplane.update(params.dt);
+    }
+
+    for (auto& pilot : pilots) {
+      if (!pilot.alive) continue;
+
+      float altitude = pilot.airplane.rigid_body.position.y;
+      if (altitude < params.min_altitude || altitude > params.max_altitude) kill(pilot, true);
+    }
+
+    // every kill of a step is found before any is applied, so pilots that get each other at once both die
+    shooters.clear();
+    for (int i = 0; i < static_cast<int>(pilots.size()); i++) {
+      auto& pilot = pilots[i];
+      if (!pilot.alive || pilot.target < 0 || !pilots[pilot.target].alive) continue;
+
+      auto& rb = pilot.airplane.rigid_body;
+      auto offset = pilots[pilot.target].airplane.rigid_body.position - rb.position;
+      float distance = glm::length(offset);
+
+      bool in_envelope = distance < params.gun_range && glm::angle(rb.forward(), offset / distance) < params.gun_cone;
+      pilot.time_on_target = in_envelope ? pilot.time_on_target + params.dt : 0.0f;
+
+      if (pilot.time_on_target >= params.time_to_kill) shooters.push_back(i);
+    }
+
+    for (int i : shooters) {
+      auto& pilot = pilots[i];
+      pilot.time_on_target = 0.0f;
+
+      // the first of several pilots on the same target gets the kill
+      if (!pilots[pilot.target].alive) continue;
+      result.teams[pilot.team].kills++;
+      result.teams[pilot.team].kill_time += time;
+      kill(pilots[pilot.target], false);
+    }
+  }
+
+  if (alive[0] > 0 && alive[1] == 0) result.winner = 0;
+  if (alive[1] > 0 && alive[0] == 0) result.winner = 1;
+  return result;
+}
+
+// every agent fights every other agent `rounds` times, engagements run on all workers of the pool
+std::vector<Score> run(const std::vector<Agent>& agents, const Params& params, jobs::ThreadPool& pool) {
+  std::vector<Result> results;
+
+  for (int i = 0; i < static_cast<int>(agents.size()); i++) {
+    for (int j = i + 1; j < static_cast<int>(agents.size()); j++) {
+      for (int round = 0; round < params.rounds; round++) {
+        // swap sides every round so neither agent profits from the starting geometry
+        Result result;
+        result.agents[0] = (round % 2 == 0) ? i : j;
+        result.agents[1] = (round % 2 == 0) ? j : i;
+        results.push_back(result);
+      }
+    }
+  }
+
+  pool.parallel_for(static_cast<int>(results.size()), [&](int index) {
+    auto& result = results[index];
+    const int a = result.agents[0], b = result.agents[1];
+    result = simulate(agents[a], agents[b], index, params);
+    result.agents[0] = a, result.agents[1] = b;
+  });
+
+  std::vector<Score> scores(agents.size());
+  for (size_t i = 0; i < agents.size(); i++) scores[i].name = agents[i].name;
+
+  for (const auto& result : results) {
+    for (int side = 0; side < 2; side++) {
+      auto& score = scores[result.agents[side]];
+      const auto& team = result.teams[side];
+
+      score.engagements++;
+      score.wins += result.winner == side ? 1 : 0;
+      score.losses += result.winner == 1 - side ? 1 : 0;
+      score.draws += result.winner < 0 ? 1 : 0;
+      score.kills += team.kills;
+      score.deaths += team.deaths;
+      score.crashes += team.crashes;
+      score.kill_time += team.kill_time;
+      score.cpu_time += team.cpu_time;
+      score.decisions += team.decisions;
+    }
+  }
+
+  return scores;
+}
+
+void print(const std::vector<Score>& scores) {
+  printf("%-16s %8s %8s %8s %8s %8s %8s %8s %10s %12s\n", "agent", "matches", "win %", "draws", "kills", "deaths",
+         "crashes", "ttk [s]", "cpu [s]", "cpu/dec [ns]");
+
+  for (const auto& s : scores) {
+    printf("%-16s %8d %8.1f %8d %8d %8d %8d %8.1f %10.3f %12.1f\n", s.name.c_str(), s.engagements,
+           s.win_rate() * 100.0f, s.draws, s.kills, s.deaths, s.crashes, s.mean_time_to_kill(), s.cpu_time,
+           s.cpu_time_per_decision() * 1e9);
+  }
+}
+
+// run 1v1 and 4v4 tournaments of the built-in policies and print the results
+void run_tournament() {
+  jobs::ThreadPool pool;
+  const auto agents = default_agents();
+
+  for (int team_size : {1, 4}) {
+    Params params{.team_size = team_size};
+
+    auto start = std::chrono::steady_clock::now();
+    auto scores = run(agents, params, pool);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("\n%dv%d, %d rounds per pairing, %.2f s on %u threads\n", team_size, team_size, params.rounds, elapsed,
+           pool.size() + 1);
+    print(scores);
+  }
+}
+};  // namespace tournament
@@ -0,0 +1,31 @@
+/*
+    Checks for the unit tests that, unlike assert, also run in release builds
+*/
+#pragma once
+
+#include <cstdio>
+
+namespace unittest {
+
+// failed checks since the start of the program
+inline int failures = 0;
+
+inline void check(bool passed, const char* condition, const char* file, int line) {
+  if (passed) return;
+  failures++;
+  printf("%s:%d: check failed: %s\n", file, line, condition);
+}
+
+// prints the result of a group of tests and returns the checks that failed in it
+inline int report(const char* name, int failures_before) {
+  const int failed = failures - failures_before;
+  if (failed == 0) {
+    printf("%s: all unit tests passed\n", name);
+  } else {
+    printf("%s: %d checks failed\n", name, failed);
+  }
+  return failed;
+}
+};  // namespace unittest
+
+#define CHECK(condition) unittest::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
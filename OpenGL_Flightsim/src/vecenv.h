@@ -0,0 +1,187 @@
+/*
+    Vectorized environment for reinforcement learning, steps many independent aircraft in lockstep
+*/
+#pragma once
+
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <random>
+#include <vector>
+
+#include "aircraft.h"
+#include "flightmodel.h"
+#include "jobs.h"
+#include "phi.h"
+
+namespace rl {
+
+// body velocity (3), angular velocity (3), orientation quaternion w, x, y, z (4), altitude (1)
+constexpr int OBSERVATION_SIZE = 11;
+
+// aileron, rudder, elevator in [-1, 1] (same order as Airplane::joystick), throttle in [0, 1]
+constexpr int ACTION_SIZE = 4;
+
+enum Done : uint8_t {
+  RUNNING = 0,
+  TERMINATED = 1,  // left the flight envelope
+  TRUNCATED = 2,   // reached max_steps
+};
+
+// reward for a single step, called after the aircraft has been updated
+typedef float RewardFunction(const Airplane& airplane);
+
+inline float survival_reward(const Airplane& airplane) { return 1.0f; }
+
+struct VecEnvParams {
+  int num_envs = 64;                         // number of independent aircraft
+  int substeps = 4;                          // physics steps per env step, actions are held constant
+  phi::Seconds dt = 0.01f;                   // physics step
+  int max_steps = 5000;                      // episodes are truncated after this many env steps
+  float min_altitude = 100.0f;               // m
+  float max_altitude = 10000.0f;             // m
+  float spawn_altitude = 3000.0f;            // m
+  float spawn_altitude_jitter = 500.0f;      // m
+  float spawn_speed = 200.0f;                // m/s
+  float spawn_heading_jitter = phi::PI;      // radians
+  uint32_t seed = 0;                         // every environment gets its own generator seeded with seed + index
+  RewardFunction* reward = survival_reward;  // defaults to +1 for every step
+};
+
+class VecEnv {
+ public:
+  VecEnv(const VecEnvParams& env_params, jobs::ThreadPool* thread_pool = nullptr)
+      : params(env_params),
+        pool(thread_pool),
+        m_observations(params.num_envs * OBSERVATION_SIZE),
+        m_terminal_observations(params.num_envs * OBSERVATION_SIZE),
+        m_actions(params.num_envs * ACTION_SIZE),
+        m_rewards(params.num_envs),
+        m_dones(params.num_envs),
+        m_steps(params.num_envs) {
+    m_airplanes.reserve(params.num_envs);
+    m_rngs.reserve(params.num_envs);
+
+    for (int i = 0; i < params.num_envs; i++) {
+      m_airplanes.push_back(make_falcon());
+      m_rngs.emplace_back(params.seed + i);
+    }
+    if (!m_airplanes.empty()) m_loadout = m_airplanes[0].loadout;
+
+    reset();
+  }
+
+  // reset every environment and write the initial observations
+  void reset() {
+    for (int i = 0; i < params.num_envs; i++) {
+      reset(i);
+      m_rewards[i] = 0.0f, m_dones[i] = RUNNING;
+      observe(i, &m_observations[i * OBSERVATION_SIZE]);
+    }
+  }
+
+  // apply actions(), advance every environment by one step and write observations, rewards and dones.
+  // finished environments are reset right away, their last observation is kept in terminal_observations()
+  void step() {
+    if (pool) {
+      pool->parallel_for(params.num_envs, [this](int i) { step(i); }, 16);
+    } else {
+      for (int i = 0; i < params.num_envs; i++) step(i);
+    }
+  }
+
+  int size() const { return params.num_envs; }
+
+  // num_envs x ACTION_SIZE, written by the caller before step()
+  float* actions() { return m_actions.data(); }
+
+  // num_envs x OBSERVATION_SIZE
+  const float* observations() const { return m_observations.data(); }
+  const float* terminal_observations() const { return m_terminal_observations.data(); }
+
+  const float* rewards() const { return m_rewards.data(); }
+  const uint8_t* dones() const { return m_dones.data(); }
+
+  const Airplane& get_airplane(int index) const { return m_airplanes[index]; }
+
+  const VecEnvParams params;
+
+ private:
+  jobs::ThreadPool* pool;
+  std::vector<Airplane> m_airplanes;
+  Loadout m_loadout;  // full tanks and stores every episode starts with
+  std::vector<std::minstd_rand> m_rngs;
+  std::vector<float> m_observations, m_terminal_observations, m_actions, m_rewards;
+  std::vector<uint8_t> m_dones;
+  std::vector<int> m_steps;
+
+  // resets the aircraft in place, assigning a new Airplane would reallocate its wings
+  void reset(int index) {
+    auto& rng = m_rngs[index];
+    std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+
+    auto& airplane = m_airplanes[index];
+    auto& rb = airplane.rigid_body;
+    rb.position = glm::vec3(0.0f, params.spawn_altitude + jitter(rng) * params.spawn_altitude_jitter, 0.0f);
+    rb.orientation = glm::angleAxis(jitter(rng) * params.spawn_heading_jitter, phi::UP);
+    rb.velocity = rb.forward() * params.spawn_speed;
+    rb.angular_velocity = glm::vec3(0.0f);
+
+    for (auto& wing : airplane.wings) {
+      wing.deflection = 0.0f, wing.control_input = 0.0f;
+    }
+
+    // the copy keeps the tensor the original inverted last, so the inverse is refreshed here
+    airplane.loadout = m_loadout;
+    rb.mass = m_loadout.get_mass();
+    rb.set_inertia(m_loadout.get_inertia());
+
+    airplane.joystick = glm::vec3(0.0f);
+    airplane.engine.throttle = 0.5f;
+    m_steps[index] = 0;
+  }
+
+  void step(int index) {
+    auto& airplane = m_airplanes[index];
+    const float* action = &m_actions[index * ACTION_SIZE];
+
+    airplane.joystick = glm::clamp(glm::vec3(action[0], action[1], action[2]), glm::vec3(-1.0f), glm::vec3(1.0f));
+    airplane.engine.throttle = glm::clamp(action[3], 0.0f, 1.0f);
+
+    uint8_t done = RUNNING;
+
+    for (int i = 0; i < params.substeps && done == RUNNING; i++) {
+      airplane.update(params.dt);
+
+      // the atmosphere model is only valid inside this range
+      const float altitude = airplane.rigid_body.position.y;
+      if (altitude < params.min_altitude || altitude > params.max_altitude) done = TERMINATED;
+    }
+
+    if (done == RUNNING && ++m_steps[index] >= params.max_steps) done = TRUNCATED;
+
+    m_rewards[index] = params.reward(airplane);
+    m_dones[index] = done;
+
+    float* observation = &m_observations[index * OBSERVATION_SIZE];
+
+    if (done != RUNNING) {
+      observe(index, &m_terminal_observations[index * OBSERVATION_SIZE]);
+      reset(index);
+    }
+
+    observe(index, observation);
+  }
+
+  void observe(int index, float* observation) const {
+    const auto& rb = m_airplanes[index].rigid_body;
+    const auto velocity = rb.get_body_velocity();
+
+    observation[0] = velocity.x, observation[1] = velocity.y, observation[2] = velocity.z;
+    observation[3] = rb.angular_velocity.x, observation[4] = rb.angular_velocity.y;
+    observation[5] = rb.angular_velocity.z;
+    observation[6] = rb.orientation.w, observation[7] = rb.orientation.x;
+    observation[8] = rb.orientation.y, observation[9] = rb.orientation.z;
+    observation[10] = rb.position.y;
+  }
+};
+};  // namespace rl